@@ -0,0 +1,223 @@
+#include "async_condition_variable.hpp"
+#include "async_mutex.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+constexpr unsigned producers = 4;
+constexpr unsigned max_threads = 256;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct AsyncQueue {
+   explicit AsyncQueue(thread_pool& pool) : not_empty{pool} {
+   }
+
+   async_mutex mutex;
+   async_condition_variable not_empty;
+   std::deque<std::uint64_t> items;
+   bool done = false;
+   std::atomic<unsigned> producers_left{producers};
+};
+
+
+task<std::uint64_t> consumer(thread_pool& pool, AsyncQueue& q) {
+   co_await pool.schedule();
+
+   std::uint64_t consumed = 0;
+   while(true) {
+      auto lock = co_await q.mutex.scoped_lock();
+      co_await q.not_empty.wait(lock, [&] { return !q.items.empty() || q.done; });
+      if(q.items.empty()) {
+         break;
+      }
+      q.items.pop_front();
+      ++consumed;
+   }
+   co_return consumed;
+}
+
+
+// Pushes batch items at a time, notifying one consumer per item or all
+// consumers per batch. The last producer to finish closes the queue.
+task<std::uint64_t> producer(thread_pool& pool, AsyncQueue& q, std::uint64_t items, std::uint64_t batch) {
+   for(std::uint64_t i = 0; i < items; i += batch) {
+      co_await pool.schedule();
+      {
+         auto lock = co_await q.mutex.scoped_lock();
+         for(std::uint64_t j = i; j < std::min(i + batch, items); ++j) {
+            q.items.push_back(j);
+         }
+      }
+      if(batch == 1) {
+         q.not_empty.notify_one();
+      } else {
+         q.not_empty.notify_all();
+      }
+   }
+
+   if(q.producers_left.fetch_sub(1) == 1) {
+      {
+         auto lock = co_await q.mutex.scoped_lock();
+         q.done = true;
+      }
+      q.not_empty.notify_all();
+   }
+   co_return 0;
+}
+
+
+double async_run(thread_pool& pool, unsigned consumers, std::uint64_t items, std::uint64_t batch) {
+   AsyncQueue q{pool};
+   std::vector<task<std::uint64_t>> tasks;
+   for(unsigned c = 0; c < consumers; ++c) {
+      tasks.push_back(consumer(pool, q));
+   }
+   for(unsigned p = 0; p < producers; ++p) {
+      tasks.push_back(producer(pool, q, items / producers, batch));
+   }
+
+   auto t0 = std::chrono::steady_clock::now();
+   auto consumed = sync_wait(when_all(std::move(tasks)));
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+   std::uint64_t total = 0;
+   for(auto c : consumed) {
+      total += c;
+   }
+   if(total != items / producers * producers) {
+      std::cerr << "consumed " << total << " of " << items << " items\n";
+      std::exit(EXIT_FAILURE);
+   }
+   return double(total) / dt.count() / 1e6;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+double std_run(unsigned consumers, std::uint64_t items, std::uint64_t batch) {
+   std::mutex mutex;
+   std::condition_variable not_empty;
+   std::deque<std::uint64_t> queue;
+   bool done = false;
+   std::atomic<std::uint64_t> total{0};
+
+   auto t0 = std::chrono::steady_clock::now();
+   {
+      std::vector<std::jthread> threads;
+      for(unsigned c = 0; c < consumers; ++c) {
+         threads.emplace_back([&] {
+            std::uint64_t consumed = 0;
+            while(true) {
+               std::unique_lock lock{mutex};
+               not_empty.wait(lock, [&] { return !queue.empty() || done; });
+               if(queue.empty()) {
+                  break;
+               }
+               queue.pop_front();
+               ++consumed;
+            }
+            total += consumed;
+         });
+      }
+
+      std::vector<std::jthread> producer_threads;
+      for(unsigned p = 0; p < producers; ++p) {
+         producer_threads.emplace_back([&] {
+            const auto n = items / producers;
+            for(std::uint64_t i = 0; i < n; i += batch) {
+               {
+                  std::lock_guard lock{mutex};
+                  for(std::uint64_t j = i; j < std::min(i + batch, n); ++j) {
+                     queue.push_back(j);
+                  }
+               }
+               if(batch == 1) {
+                  not_empty.notify_one();
+               } else {
+                  not_empty.notify_all();
+               }
+            }
+         });
+      }
+      producer_threads.clear();
+
+      {
+         std::lock_guard lock{mutex};
+         done = true;
+      }
+      not_empty.notify_all();
+   }
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+   if(total != items / producers * producers) {
+      std::cerr << "consumed " << total << " of " << items << " items\n";
+      std::exit(EXIT_FAILURE);
+   }
+   return double(total) / dt.count() / 1e6;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+task<> locked_increment(thread_pool& pool, async_mutex& m, unsigned& counter, unsigned n) {
+   for(unsigned i = 0; i < n; ++i) {
+      co_await pool.schedule();
+      auto lock = co_await m.scoped_lock();
+      ++counter;
+   }
+}
+
+
+int main(int argc, char* argv[]) {
+   const std::uint64_t items = argc > 1 ? std::stoull(argv[1]) : 1000000;
+   thread_pool pool;
+
+   {
+      async_mutex m;
+      unsigned counter = 0;
+      std::vector<task<>> tasks;
+      for(unsigned i = 0; i < 8; ++i) {
+         tasks.push_back(locked_increment(pool, m, counter, 1000));
+      }
+      sync_wait(when_all(std::move(tasks)));
+      const bool unlocked = m.try_lock();
+      if(counter != 8000 || !unlocked) {
+         std::cerr << "async_mutex lost an increment or stayed locked\n";
+         return EXIT_FAILURE;
+      }
+      m.unlock();
+   }
+
+   std::cout << pool.size() << " pool threads, " << producers << " producers, " << items << " items\n";
+   std::cout << std::setw(12) << "consumers" << std::setw(8) << "batch" << std::setw(14) << "async M/s"
+             << std::setw(14) << "std M/s" << '\n';
+   for(unsigned consumers : {16, 256, 4096}) {
+      for(std::uint64_t batch : {1, 64}) {
+         std::cout << std::setw(12) << consumers << std::setw(8) << batch << std::fixed << std::setprecision(2)
+                   << std::setw(14) << async_run(pool, consumers, items, batch);
+         if(consumers <= max_threads) {
+            std::cout << std::setw(14) << std_run(consumers, items, batch);
+         } else {
+            std::cout << std::setw(14) << "-";
+         }
+         std::cout << '\n';
+      }
+   }
+
+   return EXIT_SUCCESS;
+}
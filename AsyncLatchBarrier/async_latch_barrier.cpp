@@ -0,0 +1,190 @@
+#include "async_barrier.hpp"
+#include "async_latch.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr unsigned max_threads = 1024;
+
+
+double ns_per_arrival(clock_type::duration d, std::size_t arrivals) {
+   return std::chrono::duration<double, std::nano>(d).count() / double(arrivals);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+task<> latch_participant(thread_pool& pool, async_latch& latch) {
+   co_await pool.schedule();
+   co_await latch.arrive_and_wait();
+}
+
+
+double async_latch_run(thread_pool& pool, unsigned participants) {
+   async_latch latch{participants};
+   std::vector<task<>> tasks;
+   for(unsigned i = 0; i < participants; ++i) {
+      tasks.push_back(latch_participant(pool, latch));
+   }
+
+   auto t0 = clock_type::now();
+   sync_wait(when_all(std::move(tasks)));
+   return ns_per_arrival(clock_type::now() - t0, participants);
+}
+
+
+// Threads are started first and released together, so thread creation is not timed.
+double std_latch_run(unsigned participants) {
+   std::latch start{1}, done{participants + 1};
+   std::latch latch{participants};
+   std::vector<std::jthread> threads;
+   for(unsigned i = 0; i < participants; ++i) {
+      threads.emplace_back([&] {
+         start.wait();
+         latch.arrive_and_wait();
+         done.count_down();
+      });
+   }
+
+   auto t0 = clock_type::now();
+   start.count_down();
+   done.arrive_and_wait();
+   return ns_per_arrival(clock_type::now() - t0, participants);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct PhaseCounter {
+   unsigned* phases;
+
+   void operator()() noexcept {
+      ++*phases;
+   }
+};
+
+
+template <typename Barrier>
+task<> barrier_participant(thread_pool& pool, Barrier& barrier, unsigned phases) {
+   co_await pool.schedule();
+   for(unsigned p = 0; p < phases; ++p) {
+      co_await barrier.arrive_and_wait();
+   }
+}
+
+
+double async_barrier_run(thread_pool& pool, unsigned participants, unsigned phases) {
+   unsigned completed = 0;
+   async_barrier barrier{participants, PhaseCounter{&completed}};
+   std::vector<task<>> tasks;
+   for(unsigned i = 0; i < participants; ++i) {
+      tasks.push_back(barrier_participant(pool, barrier, phases));
+   }
+
+   auto t0 = clock_type::now();
+   sync_wait(when_all(std::move(tasks)));
+   auto dt = clock_type::now() - t0;
+   if(completed != phases) {
+      std::cerr << "async_barrier completed " << completed << " of " << phases << " phases\n";
+      std::exit(EXIT_FAILURE);
+   }
+   return ns_per_arrival(dt, std::size_t(participants) * phases);
+}
+
+
+double std_barrier_run(unsigned participants, unsigned phases) {
+   std::latch start{1}, done{participants + 1};
+   std::barrier barrier{participants};
+   std::vector<std::jthread> threads;
+   for(unsigned i = 0; i < participants; ++i) {
+      threads.emplace_back([&] {
+         start.wait();
+         for(unsigned p = 0; p < phases; ++p) {
+            barrier.arrive_and_wait();
+         }
+         done.count_down();
+      });
+   }
+
+   auto t0 = clock_type::now();
+   start.count_down();
+   done.arrive_and_wait();
+   return ns_per_arrival(clock_type::now() - t0, std::size_t(participants) * phases);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+task<> dropping_participant(thread_pool& pool, async_barrier<>& barrier, std::atomic<unsigned>& rounds) {
+   co_await pool.schedule();
+   co_await barrier.arrive_and_wait();
+   rounds.fetch_add(1);
+   barrier.arrive_and_drop();
+}
+
+
+int main(int argc, char* argv[]) {
+   const unsigned phases = argc > 1 ? unsigned(std::stoul(argv[1])) : 100;
+   thread_pool pool;
+
+   {
+      async_latch latch{2};
+      const bool early = latch.try_wait();
+      latch.count_down(2);
+      if(early || !latch.try_wait()) {
+         std::cerr << "async_latch released at the wrong count\n";
+         return EXIT_FAILURE;
+      }
+      sync_wait(latch.wait());
+   }
+
+   {
+      // Dropped participants no longer count for the following phases.
+      async_barrier barrier{3};
+      std::atomic<unsigned> rounds{0};
+      std::vector<task<>> tasks;
+      tasks.push_back(dropping_participant(pool, barrier, rounds));
+      tasks.push_back(dropping_participant(pool, barrier, rounds));
+      tasks.push_back(barrier_participant(pool, barrier, 3));
+      sync_wait(when_all(std::move(tasks)));
+      if(rounds != 2) {
+         std::cerr << "dropped barrier participants still counted\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::cout << pool.size() << " pool threads, " << phases << " barrier phases\n";
+   std::cout << std::setw(14) << "participants" << std::setw(16) << "async_latch" << std::setw(16)
+             << "std::latch" << std::setw(16) << "async_barrier" << std::setw(16) << "std::barrier"
+             << "   (ns per arrival)\n";
+   for(unsigned participants : {16, 256, 1024, 4096, 16384}) {
+      std::cout << std::setw(14) << participants << std::fixed << std::setprecision(1) << std::setw(16)
+                << async_latch_run(pool, participants);
+      if(participants <= max_threads) {
+         std::cout << std::setw(16) << std_latch_run(participants);
+      } else {
+         std::cout << std::setw(16) << "-";
+      }
+      std::cout << std::setw(16) << async_barrier_run(pool, participants, phases);
+      if(participants <= max_threads) {
+         std::cout << std::setw(16) << std_barrier_run(participants, phases);
+      } else {
+         std::cout << std::setw(16) << "-";
+      }
+      std::cout << '\n';
+   }
+
+   return EXIT_SUCCESS;
+}
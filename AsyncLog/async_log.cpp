@@ -0,0 +1,126 @@
+#include "async_log.hpp"
+#include "cotask.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+// Logs one line every time it is resumed.
+template <typename Log>
+CoTask<Promise<>> logging_coroutine(Log& log, unsigned id, unsigned resumes) {
+   for(unsigned i = 0; i < resumes; ++i) {
+      log(id, i);
+      co_await std::suspend_always{};
+   }
+}
+
+
+// Every thread resumes a coroutine of its own until it is done. Returns the
+// time per resume in ns.
+template <typename Log>
+double run(Log& log, unsigned threads, unsigned resumes) {
+   auto t0 = std::chrono::steady_clock::now();
+   {
+      std::vector<std::jthread> workers;
+      for(unsigned t = 0; t < threads; ++t) {
+         workers.emplace_back([&, t] {
+            auto c = logging_coroutine(log, t, resumes);
+            while(c.resume()) {
+            }
+         });
+      }
+   }
+   std::chrono::duration<double, std::nano> dt = std::chrono::steady_clock::now() - t0;
+   return dt.count() / (double(threads) * resumes);
+}
+
+
+// Shared stream under a global lock, like std::cout.
+struct LockedStream {
+   std::ostream& out;
+   bool flush;
+   std::mutex mutex;
+
+   void operator()(unsigned id, unsigned i) {
+      std::lock_guard lock{mutex};
+      out << "coroutine " << id << " resumed " << i << '\n';
+      if(flush) {
+         out.flush();
+      }
+   }
+};
+
+
+struct AsyncLog {
+   async_log& log;
+
+   void operator()(unsigned id, unsigned i) {
+      log.write("coroutine ", id, " resumed ", i, '\n');
+   }
+};
+
+
+std::size_t count_lines(const std::filesystem::path& path) {
+   std::ifstream in{path};
+   return std::size_t(std::count(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}, '\n'));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const unsigned resumes = argc > 1 ? unsigned(std::stoul(argv[1])) : 200000;
+   const auto path = std::filesystem::temp_directory_path() / ("async_log_" + std::to_string(::getpid()) + ".txt");
+
+   std::cout << resumes << " resumes per thread, one line logged per resume\n";
+   std::cout << std::setw(8) << "threads" << std::setw(14) << "ns/resume" << std::setw(14) << "ns/resume"
+             << std::setw(14) << "ns/resume" << std::setw(14) << "ns/resume" << std::setw(10) << "drains" << '\n';
+   std::cout << std::setw(8) << "" << std::setw(14) << "lock+flush" << std::setw(14) << "lock" << std::setw(14)
+             << "async_log" << std::setw(14) << "+ last drain" << '\n';
+
+   for(unsigned threads : {1, 2, 4, 8}) {
+      const std::size_t lines = std::size_t(threads) * resumes;
+      std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1);
+      for(bool flush : {true, false}) {
+         std::ofstream out{path};
+         LockedStream log{out, flush, {}};
+         std::cout << std::setw(14) << run(log, threads, resumes);
+      }
+
+      async_log::Stats stats;
+      {
+         std::ofstream out{path};
+         // Rings hold all the lines of a thread: none is dropped, whenever
+         // the drain gets to run.
+         async_log log{out, {.ring_size = resumes}};
+         AsyncLog sink{log};
+         auto ns = run(sink, threads, resumes);
+         auto t0 = std::chrono::steady_clock::now();
+         log.flush();
+         std::chrono::duration<double, std::nano> drain = std::chrono::steady_clock::now() - t0;
+         std::cout << std::setw(14) << ns << std::setw(14) << ns + drain.count() / double(lines);
+         stats = log.stats();
+      }
+      std::cout << std::setw(10) << stats.drains << '\n';
+
+      if(stats.dropped != 0 || stats.messages != lines || count_lines(path) != lines) {
+         std::cerr << "logged " << count_lines(path) << " of " << lines << " lines, " << stats.dropped
+                   << " dropped\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::filesystem::remove(path);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+#include "async_shared_mutex.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// Stand-in for a calibration payload; an update rewrites every constant, so
+// a reader seeing different front and back values saw a torn update.
+struct Conditions {
+   std::vector<double> constants = std::vector<double>(512, 0.);
+   unsigned version = 0;
+};
+
+
+constexpr unsigned reads_per_yield = 256;
+
+
+template <typename Mutex>
+task<unsigned> reader(thread_pool& pool, Mutex& mutex, const Conditions& conditions, unsigned reads,
+                      std::atomic<unsigned>& readers_left) {
+   co_await pool.schedule();
+
+   unsigned torn = 0;
+   for(unsigned i = 0; i < reads; ++i) {
+      if(i % reads_per_yield == reads_per_yield - 1) {
+         co_await pool.schedule();
+      }
+
+      if constexpr(std::is_same_v<Mutex, async_shared_mutex>) {
+         co_await mutex.lock_shared();
+      } else {
+         mutex.lock_shared();
+      }
+      torn += conditions.constants.front() != conditions.constants.back();
+      mutex.unlock_shared();
+   }
+
+   readers_left.fetch_sub(1, std::memory_order_release);
+   co_return torn;
+}
+
+
+// Applies an update every time it is scheduled, until the readers are done.
+template <typename Mutex>
+task<unsigned> writer(thread_pool& pool, Mutex& mutex, Conditions& conditions,
+                      std::atomic<unsigned>& readers_left) {
+   while(readers_left.load(std::memory_order_acquire) > 0) {
+      co_await pool.schedule();
+
+      if constexpr(std::is_same_v<Mutex, async_shared_mutex>) {
+         auto lock = co_await mutex.scoped_lock();
+         ++conditions.version;
+         std::fill(conditions.constants.begin(), conditions.constants.end(), double(conditions.version));
+      } else {
+         std::lock_guard lock{mutex};
+         ++conditions.version;
+         std::fill(conditions.constants.begin(), conditions.constants.end(), double(conditions.version));
+      }
+   }
+   co_return 0;
+}
+
+
+template <typename Mutex>
+void run(const char* name, thread_pool& pool, unsigned readers, unsigned reads, bool with_writer) {
+   Mutex mutex;
+   Conditions conditions;
+   std::atomic<unsigned> readers_left{readers};
+
+   std::vector<task<unsigned>> tasks;
+   for(unsigned r = 0; r < readers; ++r) {
+      tasks.push_back(reader(pool, mutex, conditions, reads, readers_left));
+   }
+   if(with_writer) {
+      tasks.push_back(writer(pool, mutex, conditions, readers_left));
+   }
+
+   auto t0 = std::chrono::steady_clock::now();
+   auto torn = sync_wait(when_all(std::move(tasks)));
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+   unsigned total_torn = 0;
+   for(auto t : torn) {
+      total_torn += t;
+   }
+   if(total_torn != 0) {
+      std::cerr << name << ": " << total_torn << " torn reads\n";
+      std::exit(EXIT_FAILURE);
+   }
+
+   std::cout << std::setw(20) << name << std::setw(10) << (with_writer ? "yes" : "no") << std::setw(10)
+             << conditions.version << std::fixed << std::setprecision(1) << std::setw(16)
+             << double(readers) * reads / dt.count() / 1e6 << '\n';
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const unsigned reads = argc > 1 ? unsigned(std::stoul(argv[1])) : 200000;
+   const unsigned threads = argc > 2 ? unsigned(std::stoul(argv[2])) : std::thread::hardware_concurrency();
+   constexpr unsigned readers = 64;
+
+   thread_pool pool{threads};
+
+   {
+      // Fast paths: readers share the lock, a writer excludes everyone.
+      async_shared_mutex m;
+      const bool first_reader = m.try_lock_shared();
+      const bool second_reader = m.try_lock_shared();
+      const bool writer_while_read = m.try_lock();
+      if(first_reader) {
+         m.unlock_shared();
+      }
+      if(second_reader) {
+         m.unlock_shared();
+      }
+      const bool writer = m.try_lock();
+      const bool reader_while_written = m.try_lock_shared();
+      if(writer) {
+         m.unlock();
+      }
+      const bool reader_after = m.try_lock_shared();
+      if(reader_after) {
+         m.unlock_shared();
+      }
+      if(!first_reader || !second_reader || writer_while_read || !writer || reader_while_written || !reader_after) {
+         std::cerr << "try_lock fast paths are wrong\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::cout << readers << " readers, " << pool.size() << " threads\n";
+   std::cout << std::setw(20) << "mutex" << std::setw(10) << "writer" << std::setw(10) << "updates"
+             << std::setw(16) << "Mreads/s" << '\n';
+   for(bool with_writer : {false, true}) {
+      run<async_shared_mutex>("async_shared_mutex", pool, readers, reads, with_writer);
+      run<std::shared_mutex>("std::shared_mutex", pool, readers, reads, with_writer);
+   }
+
+   return EXIT_SUCCESS;
+}
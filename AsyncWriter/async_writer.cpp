@@ -0,0 +1,188 @@
+#include "async_writer.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+
+constexpr unsigned producers = 64;
+
+
+// Serialized record of an event: its number, then bytes derived from it.
+void serialize(std::uint64_t event, std::vector<std::byte>& record) {
+   std::memcpy(record.data(), &event, sizeof(event));
+   for(std::size_t i = sizeof(event); i < record.size(); ++i) {
+      record[i] = std::byte(event + i);
+   }
+}
+
+
+// Returns the number of records and the sum of their event numbers.
+std::pair<std::uint64_t, std::uint64_t> read_back(const std::filesystem::path& path, std::size_t block_size,
+                                                  std::size_t record_size) {
+   std::ifstream in{path, std::ios::binary};
+   std::vector<char> block(block_size);
+   std::uint64_t records = 0, sum = 0;
+   while(in.read(block.data(), std::streamsize(block.size()))) {
+      for(std::size_t pos = 0; pos + sizeof(std::uint32_t) <= block.size();) {
+         std::uint32_t length;
+         std::memcpy(&length, block.data() + pos, sizeof(length));
+         if(length == 0) {
+            break;
+         }
+         if(length != record_size) {
+            std::cerr << "corrupt record at " << pos << '\n';
+            std::exit(EXIT_FAILURE);
+         }
+         std::uint64_t event;
+         std::memcpy(&event, block.data() + pos + sizeof(length), sizeof(event));
+         ++records;
+         sum += event;
+         pos += sizeof(length) + length;
+      }
+   }
+   return {records, sum};
+}
+
+
+task<> produce(thread_pool& pool, async_writer& writer, unsigned id, std::uint64_t records,
+               std::size_t record_size) {
+   co_await pool.schedule();
+   std::vector<std::byte> record(record_size);
+   for(std::uint64_t r = 0; r < records; ++r) {
+      serialize(id * records + r, record);
+      co_await writer.write(record);
+   }
+}
+
+
+// Every producer writes to one output stream under a lock, as with std::cout.
+task<> produce_locked(thread_pool& pool, std::ofstream& out, std::mutex& mutex, std::chrono::nanoseconds& stall,
+                      unsigned id, std::uint64_t records, std::size_t record_size) {
+   co_await pool.schedule();
+   std::vector<std::byte> record(record_size);
+   for(std::uint64_t r = 0; r < records; ++r) {
+      serialize(id * records + r, record);
+      auto t0 = std::chrono::steady_clock::now();
+      std::lock_guard lock{mutex};
+      auto length = std::uint32_t(record_size);
+      out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+      out.write(reinterpret_cast<const char*>(record.data()), std::streamsize(record.size()));
+      stall += std::chrono::steady_clock::now() - t0;
+   }
+}
+
+
+void report(const char* name, std::size_t record_size, std::uint64_t bytes, std::chrono::duration<double> dt,
+            std::chrono::nanoseconds stall) {
+   std::cout << std::setw(28) << name << std::setw(10) << record_size << std::fixed << std::setprecision(2)
+             << std::setw(10) << double(bytes) / dt.count() / 1e9 << std::setw(16)
+             << std::chrono::duration<double, std::milli>(stall).count() / producers << '\n';
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::uint64_t total_mb = argc > 1 ? std::stoull(argv[1]) : 256;
+   // O_DIRECT needs a file system supporting it, which the temporary directory may not.
+   const std::filesystem::path dir = argc > 2 ? argv[2] : std::filesystem::temp_directory_path().string();
+   const auto path = dir / ("async_writer_" + std::to_string(::getpid()) + ".bin");
+   thread_pool pool;
+
+   {
+      // Write errors reach the producers instead of ending the process.
+      async_writer writer{pool, "/dev/full", {.buffer_size = 1 << 16, .lanes = 1}};
+      int error = 0;
+      try {
+         sync_wait(produce(pool, writer, 0, 1 << 10, 256));
+         sync_wait(writer.flush());
+      } catch(const std::system_error& e) {
+         error = e.code().value();
+      }
+      if(error != ENOSPC) {
+         std::cerr << "a failed write was not reported\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::cout << producers << " producers, " << total_mb << " MB, " << pool.size() << " pool threads\n";
+   std::cout << std::setw(28) << "writer" << std::setw(10) << "record B" << std::setw(10) << "GB/s"
+             << std::setw(16) << "stall ms/prod" << '\n';
+
+   for(std::size_t record_size : {256, 4096}) {
+      const std::uint64_t records = (total_mb << 20) / record_size / producers;
+      const std::uint64_t n = records * producers;
+      const std::uint64_t expected_sum = n * (n - 1) / 2;
+
+      {
+         std::ofstream out{path, std::ios::binary};
+         std::mutex mutex;
+         std::vector<std::chrono::nanoseconds> stalls(producers);
+         std::vector<task<>> tasks;
+         for(unsigned p = 0; p < producers; ++p) {
+            tasks.push_back(produce_locked(pool, out, mutex, stalls[p], p, records, record_size));
+         }
+         auto t0 = std::chrono::steady_clock::now();
+         sync_wait(when_all(std::move(tasks)));
+         out.flush();
+         std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+         report("ofstream under a mutex", record_size, n * (record_size + 4), dt,
+                std::accumulate(stalls.begin(), stalls.end(), std::chrono::nanoseconds{}));
+      }
+
+      for(bool direct : {false, true}) {
+         for(std::size_t buffer_size : {1 << 20, 8 << 20}) {
+            std::chrono::duration<double> dt;
+            async_writer::Stats stats;
+            std::size_t block_size;
+            bool is_direct;
+            {
+               async_writer writer{pool, path, {.buffer_size = buffer_size, .direct = direct}};
+               std::vector<task<>> tasks;
+               for(unsigned p = 0; p < producers; ++p) {
+                  tasks.push_back(produce(pool, writer, p, records, record_size));
+               }
+               auto t0 = std::chrono::steady_clock::now();
+               sync_wait(when_all(std::move(tasks)));
+               sync_wait(writer.flush());
+               dt = std::chrono::steady_clock::now() - t0;
+               stats = writer.stats();
+               block_size = writer.buffer_size();
+               is_direct = writer.direct();
+            }
+            if(direct && !is_direct) {
+               std::cout << std::setw(28) << "O_DIRECT not supported" << '\n';
+               break;
+            }
+
+            auto [read, sum] = read_back(path, block_size, record_size);
+            if(read != n || sum != expected_sum || stats.bytes != n * (record_size + 4)) {
+               std::cerr << "read back " << read << " of " << n << " records\n";
+               return EXIT_FAILURE;
+            }
+            auto name = std::string{direct ? "O_DIRECT" : "buffered"} + ", " + std::to_string(buffer_size >> 20) +
+                        " MB buffers";
+            report(name.c_str(), record_size, stats.bytes, dt, stats.stall_time);
+         }
+      }
+   }
+
+   std::filesystem::remove(path);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+#include "batch_resume.hpp"
+#include "cotask.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+
+constexpr unsigned steps = 8;
+using Task = CoTask<Promise<EmptyCoYield, std::uint64_t>>;
+
+
+// A coroutine with state spread over its frame, of which every step updates
+// a word in each cache line.
+Task work(std::uint64_t seed) {
+   std::array<std::uint64_t, 24> state;
+   state.fill(seed);
+   for(unsigned s = 0; s < steps; ++s) {
+      for(unsigned i = s % 8; i < state.size(); i += 8) {
+         state[i] = state[i] * 6364136223846793005 + 1442695040888963407;
+      }
+      co_await std::suspend_always{};
+   }
+   co_return state[0] ^ state[23];
+}
+
+
+std::uint64_t checksum(const std::vector<Task>& tasks) {
+   std::uint64_t sum = 0;
+   for(const auto& t : tasks) {
+      sum += t.get_result();
+   }
+   return sum;
+}
+
+
+// The ready queue of a scheduler, in random order as far as the frames go.
+std::vector<std::coroutine_handle<>> ready(const std::vector<Task>& tasks) {
+   std::vector<std::coroutine_handle<>> handles;
+   handles.reserve(tasks.size());
+   for(const auto& t : tasks) {
+      handles.push_back(t.handle());
+   }
+   std::shuffle(handles.begin(), handles.end(), std::mt19937{1});
+   return handles;
+}
+
+
+std::vector<Task> make_tasks(std::size_t n) {
+   std::vector<Task> tasks;
+   tasks.reserve(n);
+   for(std::size_t i = 0; i < n; ++i) {
+      tasks.push_back(work(i));
+   }
+   return tasks;
+}
+
+
+// Millions of resumes per second of drive(handles), and the checksum of the
+// results.
+template <typename Drive>
+double rate(std::size_t n, Drive drive, std::uint64_t& sum) {
+   auto tasks = make_tasks(n);
+   auto handles = ready(tasks);
+   auto t0 = std::chrono::steady_clock::now();
+   drive(tasks, handles);
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   sum = checksum(tasks);
+   return double(n * (steps + 1)) / dt.count() / 1e6;
+}
+
+
+// Every coroutine to the end, one after the other: its frame stays in cache.
+void run_to_end(std::vector<Task>& tasks, std::vector<std::coroutine_handle<>>& handles) {
+   for(auto h : handles) {
+      while(!h.done()) {
+         h.resume();
+      }
+   }
+   (void)tasks;
+}
+
+
+// Round robin over the ready coroutines, one at a time.
+void one_at_a_time(std::vector<Task>&, std::vector<std::coroutine_handle<>>& handles) {
+   for(std::size_t n = handles.size(); n > 0;) {
+      std::size_t suspended = 0;
+      for(std::size_t i = 0; i < n; ++i) {
+         handles[i].resume();
+         if(!handles[i].done()) {
+            handles[suspended++] = handles[i];
+         }
+      }
+      n = suspended;
+   }
+}
+
+
+// Round robin with resume_batch.
+template <std::size_t Distance, std::size_t Lines>
+void batched(std::vector<Task>&, std::vector<std::coroutine_handle<>>& handles) {
+   std::span<std::coroutine_handle<>> ready{handles};
+   while(!ready.empty()) {
+      ready = ready.first(resume_batch<Distance, Lines>(ready));
+   }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::size_t max_frames = argc > 1 ? std::stoul(argv[1]) : std::size_t{1} << 21;
+
+   std::cout << "coroutines of " << steps + 1 << " resumes, with " << sizeof(std::array<std::uint64_t, 24>)
+             << " bytes of state, M resumes/s\n";
+   std::cout << std::setw(10) << "frames" << std::setw(12) << "run to end" << std::setw(14) << "one at a time"
+             << std::setw(16) << "batch K=4" << std::setw(10) << "K=8" << std::setw(10) << "K=16" << std::setw(14)
+             << "K=8, 1 line" << '\n';
+   std::cout << std::fixed << std::setprecision(1);
+   for(std::size_t n = 1 << 10; n <= max_frames; n *= 4) {
+      std::uint64_t expected, sum;
+      std::cout << std::setw(10) << n << std::setw(12) << rate(n, run_to_end, expected);
+      bool same = true;
+      auto column = [&](int width, auto drive) {
+         std::cout << std::setw(width) << rate(n, drive, sum);
+         same &= sum == expected;
+      };
+      column(14, one_at_a_time);
+      column(16, batched<4, 5>);
+      column(10, batched<8, 5>);
+      column(10, batched<16, 5>);
+      column(14, batched<8, 1>);
+      std::cout << '\n';
+      if(!same) {
+         std::cerr << "results differ between the drivers\n";
+         return EXIT_FAILURE;
+      }
+   }
+   return EXIT_SUCCESS;
+}
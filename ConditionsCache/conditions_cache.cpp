@@ -0,0 +1,134 @@
+#include "conditions_service.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "timer_queue.hpp"
+#include "when_all.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+
+struct Folder {
+   std::string key;
+   std::uint64_t iov_length;
+   std::size_t values;
+};
+
+
+// Every folder changes at its own interval; the shortest one models
+// run boundaries, the longest ones rarely changing geometry.
+const std::vector<Folder> folders{
+   {"beamspot", 500, 1 << 10},
+   {"calibration", 1000, 1 << 16},
+   {"alignment", 2500, 1 << 17},
+   {"geometry", 10000, 1 << 18},
+};
+
+
+void write_store(const std::filesystem::path& root, std::uint64_t events) {
+   for(const auto& f : folders) {
+      std::filesystem::create_directories(root / f.key);
+      for(std::uint64_t since = 0; since < events; since += f.iov_length) {
+         std::vector<double> values(f.values, double(since));
+         std::ofstream out{root / f.key / (std::to_string(since) + '_' + std::to_string(since + f.iov_length) + ".bin"),
+                           std::ios::binary};
+         out.write(reinterpret_cast<const char*>(values.data()), std::streamsize(values.size() * sizeof(double)));
+      }
+   }
+}
+
+
+// Fetches all folders for one event and returns the time spent waiting for them.
+task<double> process_event(thread_pool& pool, ConditionsService& conditions, std::uint64_t event_time) {
+   co_await pool.schedule();
+
+   auto t0 = std::chrono::steady_clock::now();
+   for(const auto& f : folders) {
+      auto payload = co_await conditions.get(f.key, event_time);
+      if(!payload->iov.contains(event_time) || payload->values.front() != double(payload->iov.since)) {
+         throw std::logic_error{"wrong payload for " + f.key};
+      }
+   }
+   co_return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+void run(const std::filesystem::path& root, timer_queue& timers, std::uint64_t events, unsigned slots,
+         ConditionsService::Config config) {
+   auto& pool = timers.executor();
+   ConditionsService conditions{root, timers, config};
+
+   std::vector<double> stalls;
+   stalls.reserve(events);
+   auto t0 = std::chrono::steady_clock::now();
+   for(std::uint64_t first = 0; first < events; first += slots) {
+      std::vector<task<double>> batch;
+      for(std::uint64_t e = first; e < std::min(first + slots, events); ++e) {
+         batch.push_back(process_event(pool, conditions, e));
+      }
+      auto s = sync_wait(when_all(std::move(batch)));
+      stalls.insert(stalls.end(), s.begin(), s.end());
+   }
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+   auto stats = conditions.stats();
+   auto mean = std::accumulate(stalls.begin(), stalls.end(), 0.) / double(stalls.size());
+   std::sort(stalls.begin(), stalls.end());
+   std::cout << std::setw(10) << (config.memory_budget >> 20) << std::setw(8) << stats.loads << std::setw(8)
+             << stats.evictions << std::fixed << std::setprecision(1) << std::setw(12) << mean << std::setw(12)
+             << stalls[stalls.size() / 2] << std::setw(12) << stalls[stalls.size() * 99 / 100] << std::setw(12)
+             << stalls.back() << std::setw(12) << double(events) / dt.count() << '\n';
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::uint64_t events = argc > 1 ? std::stoull(argv[1]) : 20000;
+   const auto latency = std::chrono::microseconds{argc > 2 ? std::stoll(argv[2]) : 2000};
+   constexpr unsigned slots = 16;
+
+   auto root = std::filesystem::temp_directory_path() / ("conditions_store_" + std::to_string(::getpid()));
+   write_store(root, events);
+
+   thread_pool pool;
+   timer_queue timers{pool};
+   {
+      ConditionsService conditions{root, timers, {}};
+      bool thrown = false;
+      try {
+         sync_wait(conditions.get("beamspot", events));
+      } catch(const std::out_of_range&) {
+         thrown = true;
+      }
+      auto a = sync_wait(conditions.get("calibration", 0));
+      auto b = sync_wait(conditions.get("calibration", 999));
+      if(!thrown || a != b || conditions.stats().loads != 1) {
+         std::filesystem::remove_all(root);
+         std::cerr << "expected one load per IOV and no conditions past the store\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::cout << events << " events, " << slots << " in flight, " << latency.count() << " us per load\n";
+   std::cout << std::setw(10) << "budget MB" << std::setw(8) << "loads" << std::setw(8) << "evicted"
+             << std::setw(12) << "mean us" << std::setw(12) << "p50 us" << std::setw(12) << "p99 us"
+             << std::setw(12) << "max us" << std::setw(12) << "events/s" << '\n';
+   for(std::size_t budget_mb : {64, 4, 2}) {
+      run(root, timers, events, slots, {budget_mb << 20, latency});
+   }
+
+   std::filesystem::remove_all(root);
+   return EXIT_SUCCESS;
+}
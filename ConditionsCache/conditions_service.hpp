@@ -0,0 +1,183 @@
+#pragma once
+
+#include "shared_task.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "timer_queue.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// Interval of validity [since, until) in event time.
+struct Iov {
+   std::uint64_t since;
+   std::uint64_t until;
+
+   bool contains(std::uint64_t t) const noexcept {
+      return since <= t && t < until;
+   }
+};
+
+
+struct ConditionsPayload {
+   Iov iov;
+   std::vector<double> values;
+};
+
+
+// Conditions data keyed by name and IOV, loaded from a local file store laid
+// out as <root>/<key>/<since>_<until>.bin (raw doubles). The first request
+// for an IOV starts one load on the executor of the timer queue, every
+// request arriving meanwhile suspends on the same shared_task. Loaded
+// payloads are cached and the least recently used ones are evicted once the
+// memory budget is exceeded; loads in flight are never evicted.
+class ConditionsService {
+public:
+   struct Config {
+      std::size_t memory_budget = std::size_t{64} << 20;
+      // Extra delay per load, models a remote store behind the local files.
+      // The load suspends on the timer queue meanwhile, no worker waits.
+      std::chrono::microseconds load_latency{0};
+   };
+
+   struct Stats {
+      std::uint64_t requests;
+      std::uint64_t loads;
+      std::uint64_t evictions;
+      std::size_t cached_bytes;
+   };
+
+   ConditionsService(std::filesystem::path root, timer_queue& timers, Config config)
+      : timers_{timers}, config_{config} {
+      for(const auto& key_dir : std::filesystem::directory_iterator{root}) {
+         if(!key_dir.is_directory()) {
+            continue;
+         }
+         auto& iovs = index_[key_dir.path().filename().string()];
+         for(const auto& file : std::filesystem::directory_iterator{key_dir}) {
+            auto stem = file.path().stem().string();
+            auto sep = stem.find('_');
+            if(file.path().extension() != ".bin" || sep == std::string::npos) {
+               continue;
+            }
+            Iov iov{std::stoull(stem.substr(0, sep)), std::stoull(stem.substr(sep + 1))};
+            iovs.emplace(iov.since, IovFile{iov, file.path(), file.file_size()});
+         }
+      }
+   }
+
+   ConditionsService(const ConditionsService&) = delete;
+   ConditionsService& operator=(const ConditionsService&) = delete;
+
+   // Throws std::out_of_range if no IOV of key covers event_time.
+   task<std::shared_ptr<const ConditionsPayload>> get(std::string key, std::uint64_t event_time) {
+      const IovFile& file = find(key, event_time);
+      auto load = cached_load(file);
+      co_return co_await load;
+   }
+
+   Stats stats() const {
+      std::lock_guard lock{mutex_};
+      return {requests_, loads_, evictions_, cached_bytes_};
+   }
+
+private:
+   struct IovFile {
+      Iov iov;
+      std::filesystem::path path;
+      std::size_t size;
+   };
+
+   using Load = shared_task<std::shared_ptr<const ConditionsPayload>>;
+
+   struct Entry {
+      const IovFile* file;
+      Load load;
+   };
+
+   const IovFile& find(const std::string& key, std::uint64_t event_time) const {
+      auto k = index_.find(key);
+      if(k != index_.end()) {
+         auto it = k->second.upper_bound(event_time);
+         if(it != k->second.begin() && std::prev(it)->second.iov.contains(event_time)) {
+            return std::prev(it)->second;
+         }
+      }
+      throw std::out_of_range{"no conditions for " + key + " at " + std::to_string(event_time)};
+   }
+
+   // Returns a copy of the cached load, so that eviction cannot destroy it
+   // under the feet of a waiting requester.
+   Load cached_load(const IovFile& file) {
+      std::lock_guard lock{mutex_};
+      ++requests_;
+
+      if(auto it = entries_.find(&file); it != entries_.end()) {
+         lru_.splice(lru_.begin(), lru_, it->second);
+         return it->second->load;
+      }
+
+      ++loads_;
+      lru_.push_front(Entry{&file, load(file)});
+      entries_.emplace(&file, lru_.begin());
+      cached_bytes_ += file.size;
+      evict();
+      return lru_.front().load;
+   }
+
+   void evict() {
+      auto it = lru_.end();
+      while(cached_bytes_ > config_.memory_budget && it != std::next(lru_.begin())) {
+         --it;
+         if(!it->load.is_ready()) {
+            continue;
+         }
+         cached_bytes_ -= it->file->size;
+         entries_.erase(it->file);
+         it = lru_.erase(it);
+         ++evictions_;
+      }
+   }
+
+   Load load(const IovFile& file) {
+      if(config_.load_latency.count() > 0) {
+         co_await timers_.sleep_for(config_.load_latency);
+      } else {
+         co_await timers_.executor().schedule();
+      }
+
+      auto payload = std::make_shared<ConditionsPayload>();
+      payload->iov = file.iov;
+      payload->values.resize(file.size / sizeof(double));
+      std::ifstream in{file.path, std::ios::binary};
+      if(!in.read(reinterpret_cast<char*>(payload->values.data()), std::streamsize(file.size))) {
+         throw std::runtime_error{"cannot read " + file.path.string()};
+      }
+      co_return payload;
+   }
+
+   timer_queue& timers_;
+   Config config_;
+   // Built once, read without locking afterwards.
+   std::unordered_map<std::string, std::map<std::uint64_t, IovFile>> index_;
+
+   mutable std::mutex mutex_;
+   std::list<Entry> lru_;
+   std::unordered_map<const IovFile*, std::list<Entry>::iterator> entries_;
+   std::size_t cached_bytes_ = 0;
+   std::uint64_t requests_ = 0;
+   std::uint64_t loads_ = 0;
+   std::uint64_t evictions_ = 0;
+};
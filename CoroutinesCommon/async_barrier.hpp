@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <utility>
+
+
+// Reusable phase barrier for coroutines. Arrival is a lock-free atomic
+// decrement; co_await barrier.arrive_and_wait() suspends until all expected
+// participants of the phase have arrived. The last arrival runs the
+// completion function, rearms the barrier and resumes the other waiters
+// inline, so a coroutine wanting to continue in parallel should co_await
+// its executor right after the barrier.
+//
+// As with std::barrier, each participant arrives at most once per phase.
+namespace detail {
+
+
+struct barrier_no_completion {
+   void operator()() noexcept {
+   }
+};
+
+
+}  // namespace detail
+
+
+template <typename CompletionFunction = detail::barrier_no_completion>
+class async_barrier {
+public:
+   explicit async_barrier(std::ptrdiff_t expected, CompletionFunction completion = {}) noexcept
+      : expected_{expected}, count_{expected}, completion_{std::move(completion)} {
+   }
+
+   async_barrier(const async_barrier&) = delete;
+   async_barrier& operator=(const async_barrier&) = delete;
+
+   auto arrive_and_wait() noexcept {
+      struct awaiter : waiter {
+         async_barrier& barrier_;
+
+         bool await_ready() const noexcept {
+            return false;
+         }
+
+         bool await_suspend(std::coroutine_handle<> handle) noexcept {
+            this->handle_ = handle;
+            return barrier_.arrive(this);
+         }
+
+         void await_resume() const noexcept {
+         }
+      };
+      return awaiter{{}, *this};
+   }
+
+   // Arrives without waiting for the phase to complete.
+   void arrive() noexcept {
+      arrive(nullptr);
+   }
+
+   // Arrives and leaves the barrier for all following phases.
+   void arrive_and_drop() noexcept {
+      expected_.fetch_sub(1, std::memory_order_relaxed);
+      arrive(nullptr);
+   }
+
+private:
+   struct waiter {
+      std::coroutine_handle<> handle_;
+      waiter* next_ = nullptr;
+   };
+
+   // Waiters enlist before counting down, so the phase list is complete by
+   // the time the count hits zero. Returns true if w has to suspend.
+   bool arrive(waiter* w) noexcept {
+      if(w) {
+         auto* old = waiters_.load(std::memory_order_relaxed);
+         do {
+            w->next_ = old;
+         } while(!waiters_.compare_exchange_weak(old, w, std::memory_order_release,
+                                                 std::memory_order_relaxed));
+      }
+
+      if(count_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+         return w != nullptr;
+      }
+
+      // Last arrival: nobody can enlist for the next phase before being
+      // resumed, so the list taken here is exactly this phase's waiters.
+      auto* list = waiters_.exchange(nullptr, std::memory_order_acquire);
+      completion_();
+      count_.store(expected_.load(std::memory_order_relaxed), std::memory_order_release);
+      while(list) {
+         auto* next = list->next_;
+         if(list != w) {
+            list->handle_.resume();
+         }
+         list = next;
+      }
+      return false;
+   }
+
+   std::atomic<std::ptrdiff_t> expected_;
+   std::atomic<std::ptrdiff_t> count_;
+   std::atomic<waiter*> waiters_{nullptr};
+   CompletionFunction completion_;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "async_mutex.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+#include <coroutine>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+// Condition variable for coroutines holding an async_mutex_lock. A waiter is
+// queued before the mutex is released, so a notification issued after the
+// state change can not be lost. Notified waiters are handed to the thread
+// pool, notify_all as one batch, and re-acquire the mutex there before the
+// wait completes. Spurious wakeups do not happen, but the condition may have
+// changed again by then: use the predicate overload.
+class async_condition_variable {
+public:
+   explicit async_condition_variable(thread_pool& pool) noexcept : pool_{pool} {
+   }
+
+   async_condition_variable(const async_condition_variable&) = delete;
+   async_condition_variable& operator=(const async_condition_variable&) = delete;
+
+   task<> wait(async_mutex_lock& lock) {
+      co_await suspend_awaiter{*this, *lock.mutex()};
+      co_await lock.mutex()->lock();
+   }
+
+   template <typename Predicate>
+   task<> wait(async_mutex_lock& lock, Predicate pred) {
+      while(!pred()) {
+         co_await suspend_awaiter{*this, *lock.mutex()};
+         co_await lock.mutex()->lock();
+      }
+   }
+
+   void notify_one() {
+      waiter* w;
+      {
+         std::lock_guard lock{mutex_};
+         w = head_;
+         if(w) {
+            head_ = w->next_;
+            if(!head_) {
+               tail_ = nullptr;
+            }
+         }
+      }
+      if(w) {
+         pool_.enqueue(w->handle_);
+      }
+   }
+
+   void notify_all() {
+      waiter* w;
+      {
+         std::lock_guard lock{mutex_};
+         w = std::exchange(head_, nullptr);
+         tail_ = nullptr;
+      }
+
+      std::vector<std::coroutine_handle<>> batch;
+      for(; w; w = w->next_) {
+         batch.push_back(w->handle_);
+      }
+      pool_.enqueue_bulk(batch.begin(), batch.end());
+   }
+
+private:
+   struct waiter {
+      std::coroutine_handle<> handle_;
+      waiter* next_ = nullptr;
+   };
+
+   struct suspend_awaiter : waiter {
+      async_condition_variable& cv_;
+      async_mutex& mutex_;
+
+      suspend_awaiter(async_condition_variable& cv, async_mutex& m) noexcept : cv_{cv}, mutex_{m} {
+      }
+
+      bool await_ready() const noexcept {
+         return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) noexcept {
+         handle_ = handle;
+         // Once queued this awaiter may be resumed and gone at any time.
+         auto& m = mutex_;
+         cv_.push(this);
+         m.unlock();
+      }
+
+      void await_resume() const noexcept {
+      }
+   };
+
+   void push(waiter* w) {
+      std::lock_guard lock{mutex_};
+      (tail_ ? tail_->next_ : head_) = w;
+      tail_ = w;
+   }
+
+   thread_pool& pool_;
+   // Only guards the intrusive FIFO of waiters.
+   std::mutex mutex_;
+   waiter* head_ = nullptr;
+   waiter* tail_ = nullptr;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+
+
+// Single-use countdown for coroutines. count_down() is a lock-free atomic
+// decrement; co_await latch.wait() suspends until the count reaches zero.
+// Waiters are pushed onto an intrusive lock-free stack and resumed inline,
+// in no particular order, by whoever brings the count to zero.
+class async_latch {
+public:
+   explicit async_latch(std::ptrdiff_t expected) noexcept : count_{expected} {
+      if(expected <= 0) {
+         waiters_.store(released_value(), std::memory_order_relaxed);
+      }
+   }
+
+   async_latch(const async_latch&) = delete;
+   async_latch& operator=(const async_latch&) = delete;
+
+   void count_down(std::ptrdiff_t n = 1) noexcept {
+      if(count_.fetch_sub(n, std::memory_order_acq_rel) == n) {
+         release();
+      }
+   }
+
+   bool try_wait() const noexcept {
+      return waiters_.load(std::memory_order_acquire) == released_value();
+   }
+
+   auto wait() noexcept {
+      return awaiter{*this, {}, nullptr};
+   }
+
+   // Counts down eagerly, the returned awaitable only waits.
+   auto arrive_and_wait(std::ptrdiff_t n = 1) noexcept {
+      count_down(n);
+      return wait();
+   }
+
+private:
+   struct awaiter {
+      async_latch& latch_;
+      std::coroutine_handle<> handle_;
+      awaiter* next_ = nullptr;
+
+      bool await_ready() const noexcept {
+         return latch_.try_wait();
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept {
+         handle_ = handle;
+         void* old = latch_.waiters_.load(std::memory_order_acquire);
+         do {
+            if(old == latch_.released_value()) {
+               return false;
+            }
+            next_ = static_cast<awaiter*>(old);
+         } while(!latch_.waiters_.compare_exchange_weak(old, this, std::memory_order_release,
+                                                        std::memory_order_acquire));
+         return true;
+      }
+
+      void await_resume() const noexcept {
+      }
+   };
+
+   void release() noexcept {
+      auto* w = static_cast<awaiter*>(waiters_.exchange(released_value(), std::memory_order_acq_rel));
+      while(w) {
+         auto* next = w->next_;
+         w->handle_.resume();
+         w = next;
+      }
+   }
+
+   void* released_value() const noexcept {
+      return const_cast<async_latch*>(this);
+   }
+
+   std::atomic<std::ptrdiff_t> count_;
+   // nullptr: no waiter yet, this: released, otherwise the top waiter.
+   std::atomic<void*> waiters_{nullptr};
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "cotask.hpp"
+#include "per_thread.hpp"
+#include "thread_pool.hpp"
+#include "timer_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Logging sink for hot paths: log.write(args...) copies its arguments into a
+// ring of the calling thread, without locks or system calls, and formatting
+// is deferred to a drain coroutine. The coroutine wakes up periodically on a
+// thread of its own, streams all messages with operator<< and writes them to
+// the output in one batch. The write that fills a ring up to half wakes it
+// early, which takes the locks of the timer queue and the drain's executor.
+// Messages keep their order per thread only.
+//
+// Arguments are copied as they are and must be trivially copyable: strings
+// have to be literals or otherwise outlive the drain. write() never blocks:
+// if a thread fills its ring faster than the drain empties it, the message
+// is dropped and counted in stats().
+class async_log {
+public:
+   struct Config {
+      std::size_t ring_size = 1 << 14;  // messages per thread, a power of two
+      std::chrono::microseconds drain_period{1000};
+   };
+
+   struct Stats {
+      std::uint64_t messages;
+      std::uint64_t drains;
+      std::uint64_t dropped;
+   };
+
+   // Room for the arguments of one message.
+   static constexpr std::size_t max_arguments_size = 56;
+
+   async_log(std::ostream& out, Config config) : out_{out}, config_{config} {
+      drain_.resume();
+   }
+
+   async_log(const async_log&) = delete;
+   async_log& operator=(const async_log&) = delete;
+
+   // Writes the remaining messages. Threads must have stopped logging.
+   ~async_log() {
+      stopping_ = true;
+      finished_.wait(false);
+      timers_.reset();
+      io_.reset();
+      flush();
+   }
+
+   // Returns false if the ring of the thread was full and the message dropped.
+   template <typename... Args>
+   bool write(const Args&... args) {
+      using Arguments = std::tuple<std::decay_t<const Args&>...>;
+      static_assert((std::is_trivially_copyable_v<std::decay_t<const Args&>> && ...),
+                    "log arguments are copied for deferred formatting");
+      static_assert(sizeof(Arguments) <= max_arguments_size, "too many log arguments");
+
+      auto& r = ring();
+      auto tail = r.tail.load(std::memory_order_relaxed);
+      auto head = r.head.load(std::memory_order_acquire);
+      if(tail - head == r.entries.size()) {
+         dropped_.fetch_add(1, std::memory_order_relaxed);
+         return false;
+      }
+      auto& e = r.entries[tail & (r.entries.size() - 1)];
+      e.format = &format<Arguments>;
+      ::new(static_cast<void*>(e.arguments)) Arguments{args...};
+      r.tail.store(tail + 1, std::memory_order_release);
+      if(tail + 1 - head == (r.entries.size() + 1) / 2) {
+         wake_drain();
+      }
+      return true;
+   }
+
+   // Writes out the messages logged so far, on the calling thread.
+   void flush() {
+      std::lock_guard lock{drain_mutex_};
+      std::uint64_t n = 0;
+      for(auto* r : rings_.snapshot()) {
+         auto head = r->head.load(std::memory_order_relaxed);
+         auto tail = r->tail.load(std::memory_order_acquire);
+         for(; head != tail; ++head, ++n) {
+            const auto& e = r->entries[head & (r->entries.size() - 1)];
+            e.format(buffer_, e.arguments);
+         }
+         r->head.store(head, std::memory_order_release);
+      }
+      if(n > 0) {
+         out_ << buffer_.view();
+         out_.flush();
+         buffer_.str({});
+         messages_ += n;
+      }
+      ++drains_;
+   }
+
+   Stats stats() const noexcept {
+      return {messages_.load(), drains_.load(), dropped_.load()};
+   }
+
+private:
+   struct Entry {
+      void (*format)(std::ostream&, const std::byte*);
+      alignas(std::max_align_t) std::byte arguments[max_arguments_size];
+   };
+
+   // Single producer, single consumer.
+   struct Ring {
+      explicit Ring(std::size_t size) : entries(size) {
+      }
+
+      std::vector<Entry> entries;
+      alignas(64) std::atomic<std::uint64_t> head{0};
+      alignas(64) std::atomic<std::uint64_t> tail{0};
+   };
+
+   template <typename Arguments>
+   static void format(std::ostream& out, const std::byte* arguments) {
+      std::apply([&](const auto&... a) { (out << ... << a); },
+                 *std::launder(reinterpret_cast<const Arguments*>(arguments)));
+   }
+
+   Ring& ring() {
+      return rings_.local([this] {
+         return std::make_unique<Ring>(std::bit_ceil(std::max<std::size_t>(config_.ring_size, 1)));
+      });
+   }
+
+   // Timer of the drain's sleep, cut short by wake_drain().
+   struct wake_timer : timer_queue::node {
+      thread_pool* executor_;
+      std::coroutine_handle<> handle_;
+
+      static void resume_on_executor(timer_queue::node* n) noexcept {
+         auto* self = static_cast<wake_timer*>(n);
+         self->executor_->enqueue(self->handle_);
+      }
+   };
+
+   // Sleeps for the drain period, or less if a ring fills up meanwhile.
+   auto sleep() noexcept {
+      struct awaiter {
+         async_log& log_;
+
+         bool await_ready() const noexcept {
+            return false;
+         }
+
+         void await_suspend(std::coroutine_handle<> handle) {
+            log_.wake_.handle_ = handle;
+            log_.timers_->add(&log_.wake_, timer_queue::clock::now() + log_.config_.drain_period);
+            // A ring filled up while the timer was not armed. The drain may
+            // already run again: only the one who cancels the timer resumes.
+            if(log_.wake_requested_.exchange(false)) {
+               log_.resume_drain();
+            }
+         }
+
+         void await_resume() const noexcept {
+         }
+      };
+      return awaiter{*this};
+   }
+
+   void wake_drain() {
+      wake_requested_ = true;
+      resume_drain();
+   }
+
+   void resume_drain() {
+      if(timers_->cancel(&wake_)) {
+         io_->enqueue(wake_.handle_);
+      }
+   }
+
+   CoTask<Promise<>> drain() {
+      co_await io_->schedule();
+      while(!stopping_) {
+         co_await sleep();
+         flush();
+      }
+      finished_ = true;
+      finished_.notify_one();
+   }
+
+   std::ostream& out_;
+   const Config config_;
+
+   per_thread<Ring> rings_;
+
+   // Guards the formatting buffer and the draining of the rings.
+   std::mutex drain_mutex_;
+   std::ostringstream buffer_;
+
+   std::atomic<std::uint64_t> messages_{0};
+   std::atomic<std::uint64_t> drains_{0};
+   std::atomic<std::uint64_t> dropped_{0};
+
+   std::atomic<bool> stopping_{false};
+   std::atomic<bool> finished_{false};
+   std::atomic<bool> wake_requested_{false};
+   CoTask<Promise<>> drain_ = drain();
+   // Reset once the drain coroutine has finished.
+   std::unique_ptr<thread_pool> io_ = std::make_unique<thread_pool>(1);
+   std::unique_ptr<timer_queue> timers_ = std::make_unique<timer_queue>(*io_);
+   wake_timer wake_{{&wake_timer::resume_on_executor, false, {}}, io_.get(), {}};
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <utility>
+
+
+// Mutual exclusion for coroutines. Locking is a single CAS when the mutex is
+// free; otherwise the coroutine suspends and its awaiter is pushed onto a
+// lock-free stack. unlock() hands the mutex directly to the oldest waiter and
+// resumes it inline, so ownership never goes back to the free state while
+// coroutines are queued.
+class async_mutex_lock;
+
+
+class async_mutex {
+public:
+   async_mutex() noexcept = default;
+   async_mutex(const async_mutex&) = delete;
+   async_mutex& operator=(const async_mutex&) = delete;
+
+   bool try_lock() noexcept {
+      auto old = not_locked;
+      return state_.compare_exchange_strong(old, locked_no_waiters, std::memory_order_acquire,
+                                            std::memory_order_relaxed);
+   }
+
+   auto lock() noexcept {
+      return lock_awaiter{*this, {}, nullptr};
+   }
+
+   // co_await m.scoped_lock() yields an async_mutex_lock guard.
+   auto scoped_lock() noexcept;
+
+   void unlock() noexcept {
+      auto* head = waiters_;
+      if(!head) {
+         auto old = locked_no_waiters;
+         if(state_.compare_exchange_strong(old, not_locked, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+            return;
+         }
+
+         // New waiters arrived, take them over and put them in FIFO order.
+         old = state_.exchange(locked_no_waiters, std::memory_order_acquire);
+         auto* w = reinterpret_cast<lock_awaiter*>(old);
+         while(w) {
+            auto* next = w->next_;
+            w->next_ = head;
+            head = w;
+            w = next;
+         }
+      }
+
+      waiters_ = head->next_;
+      head->handle_.resume();
+   }
+
+private:
+   struct lock_awaiter {
+      async_mutex& mutex_;
+      std::coroutine_handle<> handle_;
+      lock_awaiter* next_ = nullptr;
+
+      bool await_ready() noexcept {
+         return mutex_.try_lock();
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept {
+         handle_ = handle;
+         auto old = mutex_.state_.load(std::memory_order_acquire);
+         while(true) {
+            if(old == not_locked) {
+               if(mutex_.state_.compare_exchange_weak(old, locked_no_waiters, std::memory_order_acquire,
+                                                      std::memory_order_relaxed)) {
+                  return false;
+               }
+            } else {
+               next_ = reinterpret_cast<lock_awaiter*>(old);
+               if(mutex_.state_.compare_exchange_weak(old, reinterpret_cast<std::uintptr_t>(this),
+                                                      std::memory_order_release,
+                                                      std::memory_order_relaxed)) {
+                  return true;
+               }
+            }
+         }
+      }
+
+      void await_resume() const noexcept {
+      }
+   };
+
+   static constexpr std::uintptr_t not_locked = 1;
+   static constexpr std::uintptr_t locked_no_waiters = 0;
+
+   // not_locked, locked_no_waiters, or the newest waiter of a LIFO stack.
+   std::atomic<std::uintptr_t> state_{not_locked};
+   // FIFO of waiters already taken over by the owner; only the owner touches it.
+   lock_awaiter* waiters_ = nullptr;
+};
+
+
+// Owns a locked async_mutex and unlocks it on destruction.
+class async_mutex_lock {
+public:
+   explicit async_mutex_lock(async_mutex& m) noexcept : mutex_{&m} {
+   }
+
+   async_mutex_lock(async_mutex_lock&& l) noexcept : mutex_{std::exchange(l.mutex_, nullptr)} {
+   }
+
+   async_mutex_lock(const async_mutex_lock&) = delete;
+   async_mutex_lock& operator=(const async_mutex_lock&) = delete;
+
+   ~async_mutex_lock() {
+      if(mutex_) {
+         mutex_->unlock();
+      }
+   }
+
+   async_mutex* mutex() const noexcept {
+      return mutex_;
+   }
+
+private:
+   async_mutex* mutex_;
+};
+
+
+inline auto async_mutex::scoped_lock() noexcept {
+   struct awaiter : lock_awaiter {
+      async_mutex_lock await_resume() const noexcept {
+         return async_mutex_lock{mutex_};
+      }
+   };
+   return awaiter{{*this, {}, nullptr}};
+}
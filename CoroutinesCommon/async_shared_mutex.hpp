@@ -0,0 +1,258 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+
+// Reader-writer lock for coroutines, meant for read-mostly data such as
+// conditions. Readers take the lock with a single CAS and never suspend
+// unless a writer holds or waits for it. Writers queue as suspended
+// coroutines and have preference: once a writer waits, new readers queue
+// behind it, which bounds the update latency. Suspended coroutines are
+// resumed inline by the thread releasing the lock.
+class async_shared_mutex {
+public:
+   async_shared_mutex() noexcept = default;
+   async_shared_mutex(const async_shared_mutex&) = delete;
+   async_shared_mutex& operator=(const async_shared_mutex&) = delete;
+
+   bool try_lock_shared() noexcept {
+      auto s = state_.load(std::memory_order_relaxed);
+      while((s & writer_bits) == 0) {
+         if(state_.compare_exchange_weak(s, s + one_reader, std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   bool try_lock() noexcept {
+      std::uint64_t s = 0;
+      return state_.compare_exchange_strong(s, writer_held, std::memory_order_acquire,
+                                            std::memory_order_relaxed);
+   }
+
+   auto lock_shared() noexcept {
+      return lock_awaiter<false>{*this};
+   }
+
+   auto lock() noexcept {
+      return lock_awaiter<true>{*this};
+   }
+
+   void unlock_shared() noexcept {
+      // acq_rel: the last reader out also acquires what the other readers
+      // released, and hands the lock to the first waiting writer.
+      auto s = state_.fetch_sub(one_reader, std::memory_order_acq_rel) - one_reader;
+      if(s == writers_waiting) {
+         wake_writer();
+      }
+   }
+
+   void unlock() noexcept;
+
+   // RAII variants: co_await m.scoped_lock_shared() yields a guard.
+   class shared_guard {
+   public:
+      explicit shared_guard(async_shared_mutex& m) noexcept : mutex_{&m} {
+      }
+
+      shared_guard(shared_guard&& g) noexcept : mutex_{std::exchange(g.mutex_, nullptr)} {
+      }
+
+      shared_guard(const shared_guard&) = delete;
+      shared_guard& operator=(const shared_guard&) = delete;
+
+      ~shared_guard() {
+         if(mutex_) {
+            mutex_->unlock_shared();
+         }
+      }
+
+   private:
+      async_shared_mutex* mutex_;
+   };
+
+   class guard {
+   public:
+      explicit guard(async_shared_mutex& m) noexcept : mutex_{&m} {
+      }
+
+      guard(guard&& g) noexcept : mutex_{std::exchange(g.mutex_, nullptr)} {
+      }
+
+      guard(const guard&) = delete;
+      guard& operator=(const guard&) = delete;
+
+      ~guard() {
+         if(mutex_) {
+            mutex_->unlock();
+         }
+      }
+
+   private:
+      async_shared_mutex* mutex_;
+   };
+
+   auto scoped_lock_shared() noexcept {
+      struct awaiter : lock_awaiter<false> {
+         shared_guard await_resume() const noexcept {
+            return shared_guard{this->mutex_};
+         }
+      };
+      return awaiter{{*this}};
+   }
+
+   auto scoped_lock() noexcept {
+      struct awaiter : lock_awaiter<true> {
+         guard await_resume() const noexcept {
+            return guard{this->mutex_};
+         }
+      };
+      return awaiter{{*this}};
+   }
+
+private:
+   // Intrusive FIFO node, lives in the suspended coroutine's awaiter.
+   struct waiter {
+      std::coroutine_handle<> handle_;
+      waiter* next_ = nullptr;
+   };
+
+   struct waiter_queue {
+      waiter* head_ = nullptr;
+      waiter* tail_ = nullptr;
+
+      bool empty() const noexcept {
+         return head_ == nullptr;
+      }
+
+      void push(waiter* w) noexcept {
+         w->next_ = nullptr;
+         (tail_ ? tail_->next_ : head_) = w;
+         tail_ = w;
+      }
+
+      waiter* pop() noexcept {
+         auto* w = head_;
+         head_ = w->next_;
+         if(!head_) {
+            tail_ = nullptr;
+         }
+         return w;
+      }
+
+      waiter* take_all() noexcept {
+         tail_ = nullptr;
+         return std::exchange(head_, nullptr);
+      }
+   };
+
+   template <bool Exclusive>
+   struct lock_awaiter : waiter {
+      async_shared_mutex& mutex_;
+
+      lock_awaiter(async_shared_mutex& m) noexcept : mutex_{m} {
+      }
+
+      bool await_ready() noexcept {
+         return Exclusive ? mutex_.try_lock() : mutex_.try_lock_shared();
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept {
+         this->handle_ = handle;
+         return Exclusive ? mutex_.enqueue_writer(this) : mutex_.enqueue_reader(this);
+      }
+
+      void await_resume() const noexcept {
+      }
+   };
+
+   // Slow paths, serialized by queue_mutex_. They return false if the lock
+   // was acquired after all and the coroutine must not suspend.
+   bool enqueue_reader(waiter* w) noexcept {
+      std::lock_guard lock{queue_mutex_};
+      if(try_lock_shared()) {
+         return false;
+      }
+      readers_.push(w);
+      return true;
+   }
+
+   bool enqueue_writer(waiter* w) noexcept {
+      std::lock_guard lock{queue_mutex_};
+      auto s = state_.load(std::memory_order_relaxed);
+      while(true) {
+         if(s == 0) {
+            if(state_.compare_exchange_weak(s, writer_held, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+               return false;
+            }
+         } else if(state_.compare_exchange_weak(s, s | writers_waiting, std::memory_order_relaxed,
+                                                std::memory_order_relaxed)) {
+            writers_.push(w);
+            return true;
+         }
+      }
+   }
+
+   void wake_writer() noexcept {
+      waiter* w;
+      {
+         std::lock_guard lock{queue_mutex_};
+         w = writers_.pop();
+         // No reader can get in while writers_waiting is set, so the state is
+         // exactly writers_waiting here.
+         state_.store(writers_.empty() ? writer_held : writer_held | writers_waiting,
+                      std::memory_order_relaxed);
+      }
+      w->handle_.resume();
+   }
+
+   static constexpr std::uint64_t writer_held = 1;
+   static constexpr std::uint64_t writers_waiting = 2;
+   static constexpr std::uint64_t writer_bits = writer_held | writers_waiting;
+   static constexpr std::uint64_t one_reader = 4;
+
+   // Reader count in the upper bits, writer flags in the lowest two.
+   std::atomic<std::uint64_t> state_{0};
+   std::mutex queue_mutex_;
+   waiter_queue readers_;
+   waiter_queue writers_;
+};
+
+
+inline void async_shared_mutex::unlock() noexcept {
+   waiter* next_writer = nullptr;
+   waiter* readers = nullptr;
+   {
+      std::lock_guard lock{queue_mutex_};
+      if(!writers_.empty()) {
+         // Writer preference: hand over directly, writer_held stays set.
+         next_writer = writers_.pop();
+         state_.store(writers_.empty() ? writer_held : writer_held | writers_waiting,
+                      std::memory_order_release);
+      } else {
+         std::uint64_t n = 0;
+         for(auto* w = readers_.head_; w; w = w->next_) {
+            ++n;
+         }
+         readers = readers_.take_all();
+         state_.store(n * one_reader, std::memory_order_release);
+      }
+   }
+
+   if(next_writer) {
+      next_writer->handle_.resume();
+      return;
+   }
+   while(readers) {
+      auto* next = readers->next_;
+      readers->handle_.resume();
+      readers = next;
+   }
+}
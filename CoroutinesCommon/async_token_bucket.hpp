@@ -0,0 +1,160 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "timer_queue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+
+// Rate limiter for coroutines: co_await bucket.acquire(n) takes n tokens,
+// suspending until they are available. Tokens accrue at a fixed rate up to
+// the burst size. Suspended coroutines are served in FIFO order by a refill
+// timer on the timer_queue, which wakes all waiters it can satisfy once per
+// refill period and hands them to the thread pool as one batch. The timer is
+// only armed while coroutines are waiting.
+//
+// Tokens can be anything countable, e.g. bytes to cap bandwidth or requests
+// to cap the request rate.
+class async_token_bucket {
+public:
+   using clock = timer_queue::clock;
+
+   async_token_bucket(timer_queue& timers, double tokens_per_second, std::uint64_t burst,
+                      clock::duration refill_period = std::chrono::milliseconds{1})
+      : timers_{timers}, rate_{tokens_per_second * std::chrono::duration<double>(clock::duration{1}).count()},
+        burst_{double(burst)}, refill_period_{refill_period}, tokens_{double(burst)}, last_refill_{clock::now()} {
+      timer_.fire = &on_refill;
+      timer_.bucket_ = this;
+   }
+
+   async_token_bucket(const async_token_bucket&) = delete;
+   async_token_bucket& operator=(const async_token_bucket&) = delete;
+
+   // Must not be destroyed while coroutines are waiting.
+   ~async_token_bucket() {
+      timers_.cancel(&timer_);
+   }
+
+   // Never succeeds while other coroutines are waiting, to keep FIFO order.
+   bool try_acquire(std::uint64_t n = 1) {
+      std::lock_guard lock{mutex_};
+      return try_take(double(n));
+   }
+
+   auto acquire(std::uint64_t n = 1) {
+      if(double(n) > burst_) {
+         throw std::invalid_argument{"token bucket: request larger than burst"};
+      }
+
+      struct awaiter : waiter {
+         async_token_bucket& bucket_;
+
+         awaiter(async_token_bucket& bucket, std::uint64_t n) noexcept : bucket_{bucket} {
+            tokens_ = double(n);
+         }
+
+         bool await_ready() const noexcept {
+            return false;
+         }
+
+         bool await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+            return bucket_.suspend(this);
+         }
+
+         void await_resume() const noexcept {
+         }
+      };
+      return awaiter{*this, n};
+   }
+
+private:
+   struct waiter {
+      std::coroutine_handle<> handle_;
+      double tokens_ = 0;
+      waiter* next_ = nullptr;
+   };
+
+   struct refill_timer : timer_queue::node {
+      async_token_bucket* bucket_ = nullptr;
+   };
+
+   // Requires mutex_.
+   void refill(clock::time_point now) noexcept {
+      tokens_ = std::min(burst_, tokens_ + rate_ * double((now - last_refill_).count()));
+      last_refill_ = now;
+   }
+
+   // Requires mutex_.
+   bool try_take(double n) noexcept {
+      if(head_) {
+         return false;
+      }
+      refill(clock::now());
+      if(tokens_ < n) {
+         return false;
+      }
+      tokens_ -= n;
+      return true;
+   }
+
+   // Returns false if the tokens were taken right away.
+   bool suspend(waiter* w) {
+      std::lock_guard lock{mutex_};
+      if(try_take(w->tokens_)) {
+         return false;
+      }
+      (tail_ ? tail_->next_ : head_) = w;
+      tail_ = w;
+      if(!timer_armed_) {
+         timer_armed_ = true;
+         timers_.add(&timer_, clock::now() + refill_period_);
+      }
+      return true;
+   }
+
+   // Runs on the timer thread.
+   static void on_refill(timer_queue::node* n) noexcept {
+      auto& self = *static_cast<refill_timer*>(n)->bucket_;
+      auto& pool = self.timers_.executor();
+      std::vector<std::coroutine_handle<>> batch;
+      {
+         std::lock_guard lock{self.mutex_};
+         auto now = clock::now();
+         self.refill(now);
+         while(self.head_ && self.head_->tokens_ <= self.tokens_) {
+            self.tokens_ -= self.head_->tokens_;
+            batch.push_back(self.head_->handle_);
+            self.head_ = self.head_->next_;
+         }
+         if(!self.head_) {
+            self.tail_ = nullptr;
+            self.timer_armed_ = false;
+         } else {
+            self.timers_.add(&self.timer_, now + self.refill_period_);
+         }
+      }
+      // The bucket may be gone once its last waiters are resumed.
+      pool.enqueue_bulk(batch.begin(), batch.end());
+   }
+
+   timer_queue& timers_;
+   // Tokens per clock tick.
+   const double rate_;
+   const double burst_;
+   const clock::duration refill_period_;
+
+   std::mutex mutex_;
+   double tokens_;
+   clock::time_point last_refill_;
+   waiter* head_ = nullptr;
+   waiter* tail_ = nullptr;
+   bool timer_armed_ = false;
+   refill_timer timer_;
+};
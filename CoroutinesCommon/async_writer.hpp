@@ -0,0 +1,350 @@
+#pragma once
+
+#include "cotask.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+// Output file written in the background. Coroutines append serialized records
+// with co_await writer.write(record), which copies the record into the buffer
+// of the calling thread's lane. Every lane has two buffers: when the active one
+// is full it is handed to the writer coroutine, on a thread of its own, and
+// the other one takes over. Producers only suspend while both buffers of their
+// lane are full.
+//
+// The file is a sequence of blocks of buffer_size bytes, each holding records
+// prefixed with their uint32_t length. A zero length, or fewer than four bytes
+// left, ends the records of a block. Blocks are written with O_DIRECT where the
+// file system supports it. co_await flush() before destroying the writer.
+//
+// A failed write is not retried: the writer keeps releasing buffers without
+// writing them, and write() and flush() rethrow the error to the producers
+// from then on.
+class async_writer {
+public:
+   struct Config {
+      std::size_t buffer_size = 4 << 20;
+      unsigned lanes = std::thread::hardware_concurrency();
+      bool direct = true;
+   };
+
+   struct Stats {
+      std::uint64_t bytes;
+      std::uint64_t blocks;
+      std::uint64_t stalls;
+      std::chrono::nanoseconds stall_time;
+   };
+
+   static constexpr std::size_t alignment = 4096;
+
+   async_writer(thread_pool& pool, const std::filesystem::path& path, Config config) : pool_{pool} {
+      buffer_size_ = (std::max(config.buffer_size, alignment) + alignment - 1) / alignment * alignment;
+      constexpr int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+      if(config.direct) {
+         fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+         direct_ = fd_ >= 0;
+      }
+      // Not every file system supports O_DIRECT, tmpfs for one.
+      if(fd_ < 0) {
+         fd_ = ::open(path.c_str(), flags, 0644);
+      }
+      if(fd_ < 0) {
+         throw std::system_error{errno, std::generic_category(), path.string()};
+      }
+
+      lanes_.reserve(std::max(config.lanes, 1u));
+      for(unsigned i = 0; i < std::max(config.lanes, 1u); ++i) {
+         auto& lane = lanes_.emplace_back(std::make_unique<Lane>());
+         for(auto& b : lane->buffers) {
+            b.data = static_cast<std::byte*>(std::aligned_alloc(alignment, buffer_size_));
+            b.lane = lane.get();
+         }
+         lane->active = &lane->buffers[0];
+      }
+      writer_.resume();
+   }
+
+   async_writer(const async_writer&) = delete;
+   async_writer& operator=(const async_writer&) = delete;
+
+   ~async_writer() {
+      // Stops the writer thread before the writer coroutine goes away.
+      io_.reset();
+      for(auto& lane : lanes_) {
+         for(auto& b : lane->buffers) {
+            std::free(b.data);
+         }
+      }
+      ::close(fd_);
+   }
+
+   bool direct() const noexcept {
+      return direct_;
+   }
+
+   std::size_t buffer_size() const noexcept {
+      return buffer_size_;
+   }
+
+   Stats stats() const noexcept {
+      return {bytes_.load(), blocks_.load(), stalls_.load(), std::chrono::nanoseconds{stall_ns_.load()}};
+   }
+
+   // The record is copied before the write completes.
+   auto write(std::span<const std::byte> record) {
+      if(record.size() + sizeof(std::uint32_t) > buffer_size_) {
+         throw std::invalid_argument{"async_writer: record larger than the buffers"};
+      }
+      return write_awaiter{*this, lane(), record, false, {}, nullptr, {}};
+   }
+
+   // Writes out the records written so far. Producers must not write
+   // concurrently.
+   task<> flush() {
+      for(auto& lane : lanes_) {
+         // Once to hand over the active buffer, once to wait until it is written.
+         co_await write_awaiter{*this, *lane, {}, true, {}, nullptr, {}};
+         co_await write_awaiter{*this, *lane, {}, true, {}, nullptr, {}};
+      }
+   }
+
+private:
+   struct Lane;
+
+   struct Buffer {
+      std::byte* data = nullptr;
+      std::size_t used = 0;
+      std::uint64_t offset = 0;
+      Lane* lane = nullptr;
+   };
+
+   struct write_awaiter {
+      async_writer& writer_;
+      Lane& lane_;
+      std::span<const std::byte> record_;
+      bool flush_;
+      std::coroutine_handle<> handle_;
+      write_awaiter* next_ = nullptr;
+      std::chrono::steady_clock::time_point suspended_;
+
+      bool await_ready() {
+         std::lock_guard lock{lane_.mutex};
+         return !lane_.waiters_head && writer_.try_append(lane_, *this);
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) {
+         std::lock_guard lock{lane_.mutex};
+         if(!lane_.waiters_head && writer_.try_append(lane_, *this)) {
+            return false;
+         }
+         handle_ = handle;
+         suspended_ = std::chrono::steady_clock::now();
+         (lane_.waiters_tail ? lane_.waiters_tail->next_ : lane_.waiters_head) = this;
+         lane_.waiters_tail = this;
+         return true;
+      }
+
+      void await_resume() const {
+         writer_.rethrow_if_failed();
+      }
+   };
+
+   struct Lane {
+      std::mutex mutex;
+      Buffer buffers[2];
+      Buffer* active = nullptr;
+      // The other buffer is being written.
+      bool writing = false;
+      write_awaiter* waiters_head = nullptr;
+      write_awaiter* waiters_tail = nullptr;
+   };
+
+   Lane& lane() noexcept {
+      static std::atomic<unsigned> threads{0};
+      thread_local const unsigned thread = threads++;
+      return *lanes_[thread % lanes_.size()];
+   }
+
+   // Requires the lane mutex. Appends the record, switching buffers if the
+   // active one is full, or for a flush hands over the active buffer.
+   bool try_append(Lane& lane, const write_awaiter& w) {
+      if(!w.flush_ && lane.active->used + sizeof(std::uint32_t) + w.record_.size() <= buffer_size_) {
+         append(*lane.active, w.record_);
+         return true;
+      }
+      if(lane.writing) {
+         return false;
+      }
+      if(lane.active->used > 0) {
+         lane.writing = true;
+         submit(lane.active);
+         lane.active = lane.active == &lane.buffers[0] ? &lane.buffers[1] : &lane.buffers[0];
+         lane.active->used = 0;
+      }
+      if(!w.flush_) {
+         append(*lane.active, w.record_);
+      }
+      return true;
+   }
+
+   void append(Buffer& b, std::span<const std::byte> record) noexcept {
+      auto length = std::uint32_t(record.size());
+      std::memcpy(b.data + b.used, &length, sizeof(length));
+      std::memcpy(b.data + b.used + sizeof(length), record.data(), record.size());
+      b.used += sizeof(length) + record.size();
+   }
+
+   void submit(Buffer* b) {
+      if(b->used + sizeof(std::uint32_t) <= buffer_size_) {
+         std::memset(b->data + b->used, 0, sizeof(std::uint32_t));
+      }
+      std::coroutine_handle<> writer;
+      {
+         std::lock_guard lock{queue_mutex_};
+         b->offset = next_offset_;
+         next_offset_ += buffer_size_;
+         full_.push_back(b);
+         writer = std::exchange(writer_parked_, nullptr);
+      }
+      if(writer) {
+         io_->enqueue(writer);
+      }
+   }
+
+   // Resumes the writer coroutine once a buffer is full.
+   auto next_full() noexcept {
+      struct awaiter {
+         async_writer& writer_;
+
+         bool await_ready() noexcept {
+            return false;
+         }
+
+         bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard lock{writer_.queue_mutex_};
+            if(!writer_.full_.empty()) {
+               return false;
+            }
+            writer_.writer_parked_ = handle;
+            return true;
+         }
+
+         Buffer* await_resume() {
+            std::lock_guard lock{writer_.queue_mutex_};
+            auto* b = writer_.full_.front();
+            writer_.full_.pop_front();
+            return b;
+         }
+      };
+      return awaiter{*this};
+   }
+
+   void rethrow_if_failed() const {
+      if(failed_.load(std::memory_order_acquire)) {
+         std::rethrow_exception(error_);
+      }
+   }
+
+   // Runs on a CoTask, which must not throw: errors are kept for the
+   // producers instead.
+   CoTask<Promise<>> write_blocks() {
+      co_await io_->schedule();
+      while(true) {
+         auto* b = co_await next_full();
+         if(!failed_.load(std::memory_order_relaxed) && write_block(*b)) {
+            bytes_ += b->used;
+            ++blocks_;
+         }
+         written(*b->lane);
+      }
+   }
+
+   bool write_block(const Buffer& b) noexcept {
+      for(std::size_t done = 0; done < buffer_size_;) {
+         auto n = ::pwrite(fd_, b.data + done, buffer_size_ - done, off_t(b.offset + done));
+         if(n < 0 && errno == EINTR) {
+            continue;
+         }
+         if(n <= 0) {
+            // pwrite returning 0 would otherwise be retried forever.
+            error_ = std::make_exception_ptr(
+               std::system_error{n < 0 ? errno : EIO, std::generic_category(), "async_writer"});
+            failed_.store(true, std::memory_order_release);
+            return false;
+         }
+         done += std::size_t(n);
+      }
+      return true;
+   }
+
+   // Lets the waiting producers of the lane continue with the free buffer.
+   void written(Lane& lane) {
+      std::vector<std::coroutine_handle<>> ready;
+      {
+         std::lock_guard lock{lane.mutex};
+         auto now = std::chrono::steady_clock::now();
+         lane.writing = false;
+         while(lane.waiters_head && try_append(lane, *lane.waiters_head)) {
+            auto* w = lane.waiters_head;
+            lane.waiters_head = w->next_;
+            if(!lane.waiters_head) {
+               lane.waiters_tail = nullptr;
+            }
+            if(!w->flush_) {
+               ++stalls_;
+               stall_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(now - w->suspended_).count();
+            }
+            ready.push_back(w->handle_);
+         }
+      }
+      pool_.enqueue_bulk(ready.begin(), ready.end());
+   }
+
+   thread_pool& pool_;
+   int fd_ = -1;
+   bool direct_ = false;
+   std::size_t buffer_size_;
+   std::vector<std::unique_ptr<Lane>> lanes_;
+
+   // Guards the queue of full buffers, written in order of their offsets.
+   std::mutex queue_mutex_;
+   std::deque<Buffer*> full_;
+   std::uint64_t next_offset_ = 0;
+   std::coroutine_handle<> writer_parked_;
+
+   // Set once by the writer coroutine, read after failed_.
+   std::exception_ptr error_;
+   std::atomic<bool> failed_{false};
+
+   std::atomic<std::uint64_t> bytes_{0};
+   std::atomic<std::uint64_t> blocks_{0};
+   std::atomic<std::uint64_t> stalls_{0};
+   std::atomic<std::int64_t> stall_ns_{0};
+
+   CoTask<Promise<>> writer_ = write_blocks();
+   // Reset first on destruction, so the writer thread is joined before the
+   // rest goes away.
+   std::unique_ptr<thread_pool> io_ = std::make_unique<thread_pool>(1);
+};
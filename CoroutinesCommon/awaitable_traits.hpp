@@ -0,0 +1,39 @@
+#pragma once
+
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+
+namespace detail {
+
+
+template <typename A>
+concept has_member_co_await = requires(A&& a) { std::forward<A>(a).operator co_await(); };
+
+template <typename A>
+concept has_free_co_await = requires(A&& a) { operator co_await(std::forward<A>(a)); };
+
+
+// Resolves the awaiter object the way co_await does, minus await_transform.
+template <typename A>
+decltype(auto) get_awaiter(A&& awaitable) {
+   if constexpr(has_member_co_await<A>) {
+      return std::forward<A>(awaitable).operator co_await();
+   } else if constexpr(has_free_co_await<A>) {
+      return operator co_await(std::forward<A>(awaitable));
+   } else {
+      return std::forward<A>(awaitable);
+   }
+}
+
+
+}  // namespace detail
+
+
+template <typename A>
+using awaiter_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+// Type of a co_await expression on A.
+template <typename A>
+using await_result_t = decltype(std::declval<awaiter_t<A>&>().await_resume());
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <stop_token>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+// Single-threaded event loop over epoll. Coroutines suspend with
+// co_await reactor.readable(fd), writable(fd) or sleep_for(d), and are
+// resumed inline by whichever thread drives the loop with poll(), run_until()
+// or run(). Timers use a timerfd, so their resolution is not limited to the
+// milliseconds of epoll_wait.
+//
+// A file descriptor has to be add()ed before it is awaited, and at most one
+// coroutine may wait for it at a time. Awaiting is only allowed on the thread
+// driving the loop; wake() may be called from any thread.
+class epoll_reactor {
+public:
+   using clock = std::chrono::steady_clock;
+
+   epoll_reactor() {
+      epoll_fd_ = check(::epoll_create1(EPOLL_CLOEXEC));
+      wake_fd_ = check(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+      timer_fd_ = check(::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK));
+      // Their events carry the address of the member holding the descriptor,
+      // the events of awaited descriptors the address of a coroutine frame.
+      for(int* fd : {&wake_fd_, &timer_fd_}) {
+         epoll_event ev{};
+         ev.events = EPOLLIN;
+         ev.data.ptr = fd;
+         check(::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, *fd, &ev));
+      }
+   }
+
+   epoll_reactor(const epoll_reactor&) = delete;
+   epoll_reactor& operator=(const epoll_reactor&) = delete;
+
+   // Coroutines still waiting are not resumed.
+   ~epoll_reactor() {
+      ::close(timer_fd_);
+      ::close(wake_fd_);
+      ::close(epoll_fd_);
+   }
+
+   void add(int fd) {
+      epoll_event ev{};
+      check(::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev));
+   }
+
+   void remove(int fd) {
+      check(::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr));
+   }
+
+   auto readable(int fd) noexcept {
+      return fd_awaiter{*this, fd, EPOLLIN};
+   }
+
+   auto writable(int fd) noexcept {
+      return fd_awaiter{*this, fd, EPOLLOUT};
+   }
+
+   auto sleep_until(clock::time_point deadline) noexcept {
+      struct awaiter {
+         epoll_reactor& reactor_;
+         clock::time_point deadline_;
+
+         bool await_ready() const noexcept {
+            return deadline_ <= clock::now();
+         }
+
+         void await_suspend(std::coroutine_handle<> handle) {
+            reactor_.add_timer(deadline_, handle);
+         }
+
+         void await_resume() const noexcept {
+         }
+      };
+      return awaiter{*this, deadline};
+   }
+
+   auto sleep_for(clock::duration d) noexcept {
+      return sleep_until(clock::now() + d);
+   }
+
+   // Number of coroutines waiting for a file descriptor or a timer.
+   std::size_t waiting() const noexcept {
+      return waiting_ + timers_.size();
+   }
+
+   // Interrupts a blocking poll() from another thread.
+   void wake() {
+      std::uint64_t one = 1;
+      [[maybe_unused]] auto n = ::write(wake_fd_, &one, sizeof(one));
+   }
+
+   // Waits until at least one coroutine can be resumed or wake() is called,
+   // and resumes all that can. Returns the number of coroutines resumed.
+   std::size_t poll() {
+      epoll_event events[64];
+      int n;
+      do {
+         n = ::epoll_wait(epoll_fd_, events, 64, -1);
+      } while(n < 0 && errno == EINTR);
+      check(n);
+
+      std::size_t resumed = 0;
+      bool timers_expired = false;
+      for(int i = 0; i < n; ++i) {
+         if(events[i].data.ptr == &wake_fd_) {
+            std::uint64_t count;
+            [[maybe_unused]] auto r = ::read(wake_fd_, &count, sizeof(count));
+         } else if(events[i].data.ptr == &timer_fd_) {
+            timers_expired = true;
+         } else {
+            --waiting_;
+            ++resumed;
+            std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+         }
+      }
+      if(timers_expired) {
+         resumed += resume_expired_timers();
+      }
+      return resumed;
+   }
+
+   // Drives the loop on the calling thread until done() returns true.
+   template <typename Predicate>
+   void run_until(Predicate done) {
+      while(!done()) {
+         poll();
+      }
+   }
+
+   // Drives the loop on the calling thread until stop is requested.
+   void run(std::stop_token stop) {
+      std::stop_callback on_stop{stop, [this] { wake(); }};
+      while(!stop.stop_requested()) {
+         poll();
+      }
+   }
+
+private:
+   struct fd_awaiter {
+      epoll_reactor& reactor_;
+      int fd_;
+      std::uint32_t events_;
+
+      bool await_ready() const noexcept {
+         return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+         epoll_event ev{};
+         ev.events = events_ | EPOLLONESHOT;
+         ev.data.ptr = handle.address();
+         check(::epoll_ctl(reactor_.epoll_fd_, EPOLL_CTL_MOD, fd_, &ev));
+         ++reactor_.waiting_;
+      }
+
+      void await_resume() const noexcept {
+      }
+   };
+
+   using timer = std::pair<clock::time_point, void*>;
+
+   static int check(int result) {
+      if(result < 0) {
+         throw std::system_error{errno, std::generic_category()};
+      }
+      return result;
+   }
+
+   void add_timer(clock::time_point deadline, std::coroutine_handle<> handle) {
+      bool earliest = timers_.empty() || deadline < timers_.top().first;
+      timers_.emplace(deadline, handle.address());
+      if(earliest) {
+         arm_timer(deadline);
+      }
+   }
+
+   // steady_clock is CLOCK_MONOTONIC on Linux.
+   void arm_timer(clock::time_point deadline) {
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+      itimerspec spec{};
+      spec.it_value.tv_sec = ns / 1000000000;
+      spec.it_value.tv_nsec = ns % 1000000000;
+      if(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+         spec.it_value.tv_nsec = 1;
+      }
+      check(::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr));
+   }
+
+   std::size_t resume_expired_timers() {
+      std::uint64_t expirations;
+      [[maybe_unused]] auto r = ::read(timer_fd_, &expirations, sizeof(expirations));
+
+      std::vector<void*> expired;
+      auto now = clock::now();
+      while(!timers_.empty() && timers_.top().first <= now) {
+         expired.push_back(timers_.top().second);
+         timers_.pop();
+      }
+      if(!timers_.empty()) {
+         arm_timer(timers_.top().first);
+      }
+      for(auto* address : expired) {
+         std::coroutine_handle<>::from_address(address).resume();
+      }
+      return expired.size();
+   }
+
+   int epoll_fd_ = -1;
+   int wake_fd_ = -1;
+   int timer_fd_ = -1;
+   std::size_t waiting_ = 0;
+   std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers_;
+};
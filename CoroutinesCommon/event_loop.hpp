@@ -0,0 +1,321 @@
+#pragma once
+
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+#include "whiteboard.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+// Resident set size of the process, from /proc/self/statm.
+inline std::size_t resident_bytes() {
+   std::size_t pages = 0, resident = 0;
+   std::ifstream{"/proc/self/statm"} >> pages >> resident;
+   return resident * std::size_t(::sysconf(_SC_PAGESIZE));
+}
+
+
+// Everything an event in flight holds: its products, an arena for its
+// allocations, and the tasks it spawned. A slot is allocated once and
+// recycled from event to event, so that an event allocates nothing of its
+// own when its products fit in the arena. The arena is a monotonic buffer,
+// not thread-safe: one task of the event at a time may allocate from it.
+class event_slot {
+public:
+   event_slot(const whiteboard_schema& schema, std::size_t arena_size)
+      : board_{schema},
+        buffer_{new std::byte[arena_size]},
+        arena_{buffer_.get(), arena_size, std::pmr::new_delete_resource()} {
+   }
+
+   event_slot(const event_slot&) = delete;
+   event_slot& operator=(const event_slot&) = delete;
+
+   std::uint64_t event() const noexcept {
+      return event_;
+   }
+
+   whiteboard& board() noexcept {
+      return board_;
+   }
+
+   std::pmr::memory_resource* arena() noexcept {
+      return &arena_;
+   }
+
+   // Adds a task to the event, started once the event's process returns.
+   // The slot is recycled after all of its tasks completed.
+   void spawn(task<> t) {
+      tasks_.push_back(std::move(t));
+   }
+
+private:
+   friend class event_loop;
+
+   void recycle() noexcept {
+      board_.clear();
+      arena_.release();
+      tasks_.clear();
+   }
+
+   whiteboard board_;
+   std::unique_ptr<std::byte[]> buffer_;
+   std::pmr::monotonic_buffer_resource arena_;
+   std::vector<task<>> tasks_;
+   std::uint64_t event_ = 0;
+};
+
+
+// Runs events on a thread pool with a bounded number in flight, each in its
+// own slot. A new event is admitted only when one finishes and frees its
+// slot. Slots are created as the limit grows and destroyed, handing their
+// memory back, as it shrinks.
+//
+// With adaptive set, the limit is tuned from the throughput of each window.
+// It is first explored from the initial limit up, doubling every window
+// until the throughput drops, the slots it would add (at the memory seen per
+// slot so far) exceed memory_budget, or max_slots is reached. The loop then
+// settles at the smallest limit explored within tolerance of the best
+// throughput, the sweet spot where more slots only cost memory. It explores
+// again after patience windows slower than that, and shrinks the limit by a
+// quarter whenever the resident set exceeds memory_budget.
+class event_loop {
+public:
+   struct Config {
+      std::size_t slots = 4;  // initial limit, fixed unless adaptive
+      std::size_t max_slots = 256;
+      bool adaptive = true;
+      std::size_t memory_budget = std::size_t{1} << 30;
+      std::size_t arena_size = std::size_t{1} << 20;
+      std::chrono::milliseconds window{200};
+      double tolerance = 0.05;
+      unsigned patience = 3;  // slow windows before exploring again
+   };
+
+   struct Sample {
+      double seconds;
+      std::size_t slots;
+      double events_per_second;
+      std::size_t resident_bytes;
+   };
+
+   struct Stats {
+      std::uint64_t events;
+      double seconds;
+      std::size_t peak_resident_bytes;
+      std::size_t slots;  // limit at the end
+      std::vector<Sample> windows;
+   };
+
+   event_loop(thread_pool& pool, const whiteboard_schema& schema, Config config)
+      : pool_{pool}, schema_{schema}, config_{config} {
+      config_.max_slots = std::max<std::size_t>(config_.max_slots, 1);
+      config_.slots = std::clamp<std::size_t>(config_.slots, 1, config_.max_slots);
+   }
+
+   event_loop(const event_loop&) = delete;
+   event_loop& operator=(const event_loop&) = delete;
+
+   // Runs co_await process(slot) for events 0 to events - 1, then the tasks
+   // it spawned, and returns when all completed. Rethrows the first
+   // exception of an event, once the others completed.
+   template <typename Process>
+   Stats run(std::uint64_t events, Process process) {
+      using clock = std::chrono::steady_clock;
+      const auto start = clock::now();
+      const std::size_t base_resident = resident_bytes();
+      Stats stats{events, 0, base_resident, 0, {}};
+      limit_ = config_.slots;
+      exploring_ = true;
+      explored_.clear();
+      best_ = 0;
+      slow_windows_ = 0;
+      per_slot_ = 0;
+
+      std::unique_lock lock{mutex_};
+      std::uint64_t admitted = 0, completed_before = completed_ = 0;
+      auto window_start = start;
+      while(completed_ < events) {
+         if(admitted < events && in_flight_ < limit_) {
+            event_slot* slot = take_slot();
+            slot->event_ = admitted++;
+            ++in_flight_;
+            lock.unlock();
+            run_event(*this, *slot, process);
+            lock.lock();
+            continue;
+         }
+         cv_.wait_until(lock, window_start + config_.window);
+         if(const auto now = clock::now(); now >= window_start + config_.window) {
+            const auto resident = resident_bytes();
+            const double rate = double(completed_ - completed_before) /
+                                std::chrono::duration<double>(now - window_start).count();
+            stats.windows.push_back({std::chrono::duration<double>(now - start).count(), limit_, rate, resident});
+            stats.peak_resident_bytes = std::max(stats.peak_resident_bytes, resident);
+            if(config_.adaptive) {
+               if(!slots_.empty() && resident > base_resident) {
+                  per_slot_ = std::max(per_slot_, (resident - base_resident) / slots_.size());
+               }
+               adapt(rate, resident);
+            }
+            completed_before = completed_;
+            window_start = now;
+         }
+      }
+      stats.peak_resident_bytes = std::max(stats.peak_resident_bytes, resident_bytes());
+      stats.seconds = std::chrono::duration<double>(clock::now() - start).count();
+      stats.slots = limit_;
+      if(auto e = std::exchange(exception_, nullptr)) {
+         std::rethrow_exception(e);
+      }
+      return stats;
+   }
+
+private:
+   // Fire-and-forget coroutine running one event; frees its own frame.
+   struct event_runner {
+      struct promise_type {
+         event_runner get_return_object() noexcept {
+            return {};
+         }
+
+         auto initial_suspend() noexcept {
+            return std::suspend_never{};
+         }
+
+         auto final_suspend() noexcept {
+            return std::suspend_never{};
+         }
+
+         void unhandled_exception() noexcept {
+            std::terminate();
+         }
+
+         void return_void() noexcept {
+         }
+      };
+   };
+
+   template <typename Process>
+   static event_runner run_event(event_loop& loop, event_slot& slot, Process& process) {
+      std::exception_ptr exception;
+      try {
+         co_await loop.pool_.schedule();
+         co_await process(slot);
+         co_await when_all(std::move(slot.tasks_));
+      } catch(...) {
+         exception = std::current_exception();
+      }
+      loop.release(slot, std::move(exception));
+   }
+
+   // Called with mutex_ held.
+   event_slot* take_slot() {
+      if(free_.empty()) {
+         slots_.push_back(std::make_unique<event_slot>(schema_, config_.arena_size));
+         return slots_.back().get();
+      }
+      auto* slot = free_.back();
+      free_.pop_back();
+      return slot;
+   }
+
+   void release(event_slot& slot, std::exception_ptr exception) {
+      slot.recycle();
+      std::lock_guard lock{mutex_};
+      if(exception && !exception_) {
+         exception_ = std::move(exception);
+      }
+      if(slots_.size() > limit_) {
+         slots_.erase(std::ranges::find(slots_, &slot, &std::unique_ptr<event_slot>::get));
+      } else {
+         free_.push_back(&slot);
+      }
+      --in_flight_;
+      ++completed_;
+      // Notified under the lock: run() may return, and the loop go away,
+      // as soon as it is released.
+      cv_.notify_one();
+   }
+
+   // Called with mutex_ held.
+   void adapt(double rate, std::size_t resident) {
+      if(resident > config_.memory_budget) {
+         limit_ -= std::min(limit_ - 1, std::max<std::size_t>(limit_ / 4, 1));
+         std::erase_if(explored_, [&](const auto& e) { return e.first > limit_; });
+         if(exploring_) {
+            settle();
+         }
+      } else if(exploring_) {
+         explored_.emplace_back(limit_, rate);
+         best_ = std::max(best_, rate);
+         if(limit_ < config_.max_slots && rate >= best_ * (1 - config_.tolerance) &&
+            resident + per_slot_ * limit_ <= config_.memory_budget) {
+            limit_ = std::min(2 * limit_, config_.max_slots);
+         } else {
+            settle();
+         }
+      } else if(rate < best_ * (1 - config_.tolerance)) {
+         if(++slow_windows_ == config_.patience) {
+            // The events changed: explore again.
+            exploring_ = true;
+            explored_.clear();
+            best_ = 0;
+            limit_ = 1;
+         }
+      } else {
+         slow_windows_ = 0;
+      }
+      // Surplus slots that are free go now, the busy ones when they finish.
+      while(slots_.size() > limit_ && !free_.empty()) {
+         slots_.erase(std::ranges::find(slots_, free_.back(), &std::unique_ptr<event_slot>::get));
+         free_.pop_back();
+      }
+   }
+
+   // Ends exploring at the smallest limit within tolerance of the best.
+   void settle() {
+      exploring_ = false;
+      slow_windows_ = 0;
+      std::ranges::sort(explored_);
+      for(auto [limit, rate] : explored_) {
+         if(rate >= best_ * (1 - config_.tolerance)) {
+            limit_ = limit;
+            break;
+         }
+      }
+   }
+
+   thread_pool& pool_;
+   const whiteboard_schema& schema_;
+   Config config_;
+
+   std::mutex mutex_;
+   std::condition_variable cv_;
+   std::vector<std::unique_ptr<event_slot>> slots_;
+   std::vector<event_slot*> free_;
+   std::size_t limit_ = 0;
+   std::size_t in_flight_ = 0;
+   std::uint64_t completed_ = 0;
+   std::exception_ptr exception_;
+
+   bool exploring_ = true;
+   std::vector<std::pair<std::size_t, double>> explored_;  // limits and their throughput
+   double best_ = 0;
+   unsigned slow_windows_ = 0;
+   std::size_t per_slot_ = 0;
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "per_thread.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+// Fixed-width binning of [low, high), with an underflow bin first and an
+// overflow bin last.
+struct histogram_axis {
+   std::size_t bins;
+   double low;
+   double high;
+
+   std::size_t index(double x) const noexcept {
+      if(!(x >= low)) {
+         return 0;
+      }
+      if(x >= high) {
+         return bins + 1;
+      }
+      // Rounding may put x just below high at bins.
+      return std::min(bins - 1, std::size_t((x - low) * (double(bins) / (high - low)))) + 1;
+   }
+};
+
+
+class histogram {
+public:
+   explicit histogram(histogram_axis axis) : axis_{axis}, counts_(axis.bins + 2, 0.) {
+   }
+
+   const histogram_axis& axis() const noexcept {
+      return axis_;
+   }
+
+   void fill(double x, double weight = 1.) noexcept {
+      counts_[axis_.index(x)] += weight;
+   }
+
+   // Including under- and overflow.
+   const std::vector<double>& counts() const noexcept {
+      return counts_;
+   }
+
+   std::vector<double>& counts() noexcept {
+      return counts_;
+   }
+
+   histogram& operator+=(const histogram& h) noexcept {
+      for(std::size_t i = 0; i < counts_.size(); ++i) {
+         counts_[i] += h.counts_[i];
+      }
+      return *this;
+   }
+
+private:
+   histogram_axis axis_;
+   std::vector<double> counts_;
+};
+
+
+// Histogram filled concurrently: every thread fills bins of its own, on cache
+// lines of their own, without atomic read-modify-writes. merge() adds up the
+// threads' bins pairwise in a tree. It may run while threads are filling and
+// then sees each bin as of some moment during the merge.
+class histogram_sink {
+public:
+   explicit histogram_sink(histogram_axis axis) : axis_{axis} {
+   }
+
+   histogram_sink(const histogram_sink&) = delete;
+   histogram_sink& operator=(const histogram_sink&) = delete;
+
+   const histogram_axis& axis() const noexcept {
+      return axis_;
+   }
+
+   void fill(double x, double weight = 1.) noexcept {
+      // Only this thread writes its bins; the atomic store lets merges read them.
+      std::atomic_ref<double> bin{local().counts[axis_.index(x)]};
+      bin.store(bin.load(std::memory_order_relaxed) + weight, std::memory_order_relaxed);
+   }
+
+   std::size_t threads() const {
+      return slots_.size();
+   }
+
+   histogram merge() const {
+      auto slots = slots_.snapshot();
+      if(slots.empty()) {
+         return histogram{axis_};
+      }
+      return reduce(slots, 0, slots.size());
+   }
+
+   // Runs the branches of the tree on the thread pool.
+   task<histogram> merge(thread_pool& pool) const {
+      auto slots = slots_.snapshot();
+      if(slots.empty()) {
+         co_return histogram{axis_};
+      }
+      co_return co_await reduce(pool, slots, 0, slots.size());
+   }
+
+private:
+   struct slot {
+      struct deleter {
+         void operator()(double* p) const noexcept {
+            ::operator delete[](p, std::align_val_t{cache_line});
+         }
+      };
+
+      static constexpr std::size_t cache_line = 64;
+
+      explicit slot(std::size_t bins) {
+         auto bytes = (bins * sizeof(double) + cache_line - 1) / cache_line * cache_line;
+         counts.reset(static_cast<double*>(::operator new[](bytes, std::align_val_t{cache_line})));
+         std::fill_n(counts.get(), bytes / sizeof(double), 0.);
+      }
+
+      std::unique_ptr<double[], deleter> counts;
+   };
+
+   slot& local() {
+      return slots_.local([this] { return std::make_unique<slot>(axis_.bins + 2); });
+   }
+
+   void add(histogram& h, const slot& s) const noexcept {
+      auto& counts = h.counts();
+      for(std::size_t i = 0; i < counts.size(); ++i) {
+         counts[i] += std::atomic_ref<double>{s.counts[i]}.load(std::memory_order_relaxed);
+      }
+   }
+
+   histogram reduce(const std::vector<const slot*>& slots, std::size_t first, std::size_t last) const {
+      if(last - first == 1) {
+         histogram h{axis_};
+         add(h, *slots[first]);
+         return h;
+      }
+      auto middle = first + (last - first) / 2;
+      auto h = reduce(slots, first, middle);
+      h += reduce(slots, middle, last);
+      return h;
+   }
+
+   task<histogram> reduce(thread_pool& pool, const std::vector<const slot*>& slots, std::size_t first,
+                          std::size_t last) const {
+      co_await pool.schedule();
+      if(last - first == 1) {
+         histogram h{axis_};
+         add(h, *slots[first]);
+         co_return h;
+      }
+      auto middle = first + (last - first) / 2;
+      std::vector<task<histogram>> halves;
+      halves.push_back(reduce(pool, slots, first, middle));
+      halves.push_back(reduce(pool, slots, middle, last));
+      auto merged = co_await when_all(std::move(halves));
+      merged[0] += merged[1];
+      co_return std::move(merged[0]);
+   }
+
+   const histogram_axis axis_;
+   per_thread<slot> slots_;
+};
+
+
+// For comparison: one set of bins shared by all threads, filled with atomic
+// adds.
+class atomic_histogram {
+public:
+   explicit atomic_histogram(histogram_axis axis) : axis_{axis}, counts_(axis.bins + 2) {
+   }
+
+   void fill(double x, double weight = 1.) noexcept {
+      counts_[axis_.index(x)].fetch_add(weight, std::memory_order_relaxed);
+   }
+
+   histogram snapshot() const {
+      histogram h{axis_};
+      for(std::size_t i = 0; i < counts_.size(); ++i) {
+         h.counts()[i] = counts_[i].load(std::memory_order_relaxed);
+      }
+      return h;
+   }
+
+private:
+   histogram_axis axis_;
+   std::vector<std::atomic<double>> counts_;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// One object of type T per thread that used its owner, e.g. the ring of a
+// logger or the bins of a histogram. local() is lock-free once the thread
+// has its object: it is cached for the last per_thread the thread used, and
+// the id tells apart per_threads reusing an address. Objects stay until the
+// per_thread is destroyed, also after their thread has exited.
+template <typename T>
+class per_thread {
+public:
+   per_thread() = default;
+
+   per_thread(const per_thread&) = delete;
+   per_thread& operator=(const per_thread&) = delete;
+
+   // Object of the calling thread, the std::unique_ptr<T> returned by make()
+   // on its first call.
+   template <typename Make>
+   T& local(Make&& make) {
+      auto& c = cache();
+      if(c.id != id_) {
+         const auto thread = std::this_thread::get_id();
+         std::lock_guard lock{mutex_};
+         auto it = std::find_if(objects_.begin(), objects_.end(), [&](const auto& o) { return o.first == thread; });
+         c.object = it != objects_.end() ? it->second.get() : objects_.emplace_back(thread, make()).second.get();
+         c.id = id_;
+      }
+      return *c.object;
+   }
+
+   // The objects so far, to read from any thread.
+   std::vector<T*> snapshot() {
+      return collect<T>();
+   }
+
+   std::vector<const T*> snapshot() const {
+      return collect<const T>();
+   }
+
+   std::size_t size() const {
+      std::lock_guard lock{mutex_};
+      return objects_.size();
+   }
+
+private:
+   struct cached {
+      std::uint64_t id = 0;
+      T* object = nullptr;
+   };
+
+   static cached& cache() noexcept {
+      thread_local cached c;
+      return c;
+   }
+
+   template <typename U>
+   std::vector<U*> collect() const {
+      std::lock_guard lock{mutex_};
+      std::vector<U*> objects;
+      for(const auto& o : objects_) {
+         objects.push_back(o.second.get());
+      }
+      return objects;
+   }
+
+   static std::uint64_t next_id() noexcept {
+      static std::atomic<std::uint64_t> ids{0};
+      return ++ids;
+   }
+
+   const std::uint64_t id_ = next_id();
+   mutable std::mutex mutex_;
+   std::vector<std::pair<std::thread::id, std::unique_ptr<T>>> objects_;
+};
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+// Lazily started coroutine whose result can be awaited by any number of
+// coroutines. Copies share ownership of the coroutine frame, the first
+// co_await starts it, and every awaiter that arrives before completion is
+// pushed onto an intrusive list living in its own awaiter object, so no
+// allocation is made per waiter. The result is handed out by const reference.
+template <typename T = void>
+class shared_task;
+
+
+namespace detail {
+
+
+struct shared_task_waiter {
+   std::coroutine_handle<> continuation_;
+   shared_task_waiter* next_;
+};
+
+
+class shared_task_promise_base {
+public:
+   // Not started until the first awaiter arrives.
+   auto initial_suspend() noexcept {
+      return std::suspend_always{};
+   }
+
+   // Resumes every queued awaiter, oldest first, and keeps the frame alive
+   // for later awaiters until the last shared_task copy is gone.
+   auto final_suspend() noexcept {
+      struct final_awaiter {
+         shared_task_promise_base& promise_;
+
+         bool await_ready() const noexcept {
+            return false;
+         }
+
+         void await_suspend(std::coroutine_handle<>) noexcept {
+            void* head = promise_.state_.exchange(promise_.ready_value(), std::memory_order_acq_rel);
+            auto* waiter = static_cast<shared_task_waiter*>(head);
+
+            // The list was built by pushing at the head, reverse it for FIFO wakeup.
+            shared_task_waiter* fifo = nullptr;
+            while(waiter) {
+               auto* next = waiter->next_;
+               waiter->next_ = fifo;
+               fifo = waiter;
+               waiter = next;
+            }
+
+            while(fifo) {
+               // Read next_ before resuming, the awaiter may go away right after.
+               auto* next = fifo->next_;
+               fifo->continuation_.resume();
+               fifo = next;
+            }
+         }
+
+         void await_resume() const noexcept {
+         }
+      };
+      return final_awaiter{*this};
+   }
+
+   void unhandled_exception() noexcept {
+      exception_ = std::current_exception();
+   }
+
+   bool is_ready() const noexcept {
+      return state_.load(std::memory_order_acquire) == ready_value();
+   }
+
+   // Returns false if the result is already available and the awaiter
+   // must not suspend. Starts the coroutine if this is the first awaiter.
+   bool try_await(shared_task_waiter* waiter, std::coroutine_handle<> coroutine) {
+      void* old = state_.load(std::memory_order_acquire);
+      if(old == not_started_value() &&
+         state_.compare_exchange_strong(old, nullptr, std::memory_order_relaxed)) {
+         // Runs until the first suspension point or to completion.
+         coroutine.resume();
+         old = state_.load(std::memory_order_acquire);
+      }
+
+      do {
+         if(old == ready_value()) {
+            return false;
+         }
+         waiter->next_ = static_cast<shared_task_waiter*>(old);
+      } while(!state_.compare_exchange_weak(old, waiter, std::memory_order_release,
+                                            std::memory_order_acquire));
+      return true;
+   }
+
+   void add_ref() noexcept {
+      ref_count_.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   // Returns true if the caller dropped the last reference.
+   bool release_ref() noexcept {
+      return ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+   }
+
+protected:
+   void rethrow_if_exception() const {
+      if(exception_) {
+         std::rethrow_exception(exception_);
+      }
+   }
+
+private:
+   // State encoding:
+   //    &state_ - not started
+   //    nullptr - running, no awaiter yet
+   //    this    - result available
+   //    other   - head of the waiter list
+   void* not_started_value() noexcept {
+      return &state_;
+   }
+
+   void* ready_value() const noexcept {
+      return const_cast<shared_task_promise_base*>(this);
+   }
+
+   // ref_count_ comes first so that &state_ never equals this.
+   std::atomic<std::size_t> ref_count_{1};
+   std::atomic<void*> state_{&state_};
+   std::exception_ptr exception_;
+};
+
+
+template <typename T>
+class shared_task_promise : public shared_task_promise_base {
+public:
+   ~shared_task_promise() {
+      if(is_ready() && has_value_) {
+         std::destroy_at(value_ptr());
+      }
+   }
+
+   shared_task<T> get_return_object() noexcept;
+
+   template <typename U>
+      requires std::is_convertible_v<U&&, T>
+   void return_value(U&& value) {
+      std::construct_at(value_ptr(), std::forward<U>(value));
+      has_value_ = true;
+   }
+
+   const T& result() const {
+      rethrow_if_exception();
+      return *value_ptr();
+   }
+
+private:
+   T* value_ptr() noexcept {
+      return std::launder(reinterpret_cast<T*>(&storage_));
+   }
+
+   const T* value_ptr() const noexcept {
+      return std::launder(reinterpret_cast<const T*>(&storage_));
+   }
+
+   alignas(T) std::byte storage_[sizeof(T)];
+   bool has_value_ = false;
+};
+
+
+template <>
+class shared_task_promise<void> : public shared_task_promise_base {
+public:
+   shared_task<void> get_return_object() noexcept;
+
+   void return_void() noexcept {
+   }
+
+   void result() const {
+      rethrow_if_exception();
+   }
+};
+
+
+}  // namespace detail
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class [[nodiscard]] shared_task {
+public:
+   using promise_type = detail::shared_task_promise<T>;
+   using handle_type = std::coroutine_handle<promise_type>;
+
+   shared_task() noexcept = default;
+
+   explicit shared_task(handle_type handle) noexcept : handle_{handle} {
+   }
+
+   shared_task(const shared_task& st) noexcept : handle_{st.handle_} {
+      if(handle_) {
+         handle_.promise().add_ref();
+      }
+   }
+
+   shared_task(shared_task&& st) noexcept : handle_{std::exchange(st.handle_, nullptr)} {
+   }
+
+   shared_task& operator=(const shared_task& st) noexcept {
+      if(handle_ != st.handle_) {
+         release();
+         handle_ = st.handle_;
+         if(handle_) {
+            handle_.promise().add_ref();
+         }
+      }
+      return *this;
+   }
+
+   shared_task& operator=(shared_task&& st) noexcept {
+      if(this != &st) {
+         release();
+         handle_ = std::exchange(st.handle_, nullptr);
+      }
+      return *this;
+   }
+
+   ~shared_task() {
+      release();
+   }
+
+   bool is_ready() const noexcept {
+      return !handle_ || handle_.promise().is_ready();
+   }
+
+   // Awaiting yields const T& (or void); the referenced value lives as long
+   // as any copy of the shared_task.
+   auto operator co_await() const noexcept {
+      struct awaiter : detail::shared_task_waiter {
+         handle_type handle_;
+
+         bool await_ready() const noexcept {
+            return handle_.promise().is_ready();
+         }
+
+         bool await_suspend(std::coroutine_handle<> awaiting) {
+            continuation_ = awaiting;
+            return handle_.promise().try_await(this, handle_);
+         }
+
+         decltype(auto) await_resume() const {
+            return handle_.promise().result();
+         }
+      };
+      return awaiter{{}, handle_};
+   }
+
+private:
+   void release() noexcept {
+      if(handle_ && handle_.promise().release_ref()) {
+         handle_.destroy();
+      }
+      handle_ = nullptr;
+   }
+
+   handle_type handle_;
+};
+
+
+namespace detail {
+
+
+template <typename T>
+shared_task<T> shared_task_promise<T>::get_return_object() noexcept {
+   return shared_task<T>{std::coroutine_handle<shared_task_promise>::from_promise(*this)};
+}
+
+
+inline shared_task<void> shared_task_promise<void>::get_return_object() noexcept {
+   return shared_task<void>{std::coroutine_handle<shared_task_promise>::from_promise(*this)};
+}
+
+
+}  // namespace detail
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+// Structure-of-arrays storage: one contiguous column per field, so that
+// kernels over a field load consecutive values into vector registers. Fields
+// are tag types naming the element type:
+//
+//    struct x : soa_field<float> {};
+//    struct energy : soa_field<float> {};
+//    soa<x, energy> hits;
+//    hits.push_back(1.f, 10.f);
+//    std::span<float> e = hits.get<energy>();
+//
+// Every column starts on a cache line, and capacities are rounded up to whole
+// cache lines, so that kernels may process the last values with full-width
+// aligned vector loads and stores. Values beyond size() are zero.
+template <typename T>
+struct soa_field {
+   static_assert(std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>);
+   using type = T;
+};
+
+
+namespace detail {
+
+
+template <typename F, typename... Fields>
+constexpr std::size_t soa_index() noexcept {
+   constexpr bool matches[] = {std::is_same_v<F, Fields>...};
+   static_assert(std::count(std::begin(matches), std::end(matches), true) == 1, "not a field of this soa");
+   return std::size_t(std::find(std::begin(matches), std::end(matches), true) - std::begin(matches));
+}
+
+
+}  // namespace detail
+
+
+// Non-owning view of a range of entries of an soa, cheap to copy and to
+// co_yield from a Promise<soa_view<...>> coroutine.
+template <typename... Fields>
+class soa_view {
+public:
+   soa_view() = default;
+
+   soa_view(std::tuple<typename Fields::type*...> columns, std::size_t size) noexcept
+      : columns_{columns}, size_{size} {
+   }
+
+   std::size_t size() const noexcept {
+      return size_;
+   }
+
+   bool empty() const noexcept {
+      return size_ == 0;
+   }
+
+   template <typename F>
+   std::span<typename F::type> get() const noexcept {
+      return {std::get<detail::soa_index<F, Fields...>()>(columns_), size_};
+   }
+
+   soa_view subview(std::size_t first, std::size_t count) const noexcept {
+      return {std::apply([&](auto*... c) { return std::tuple{c + first...}; }, columns_), count};
+   }
+
+private:
+   std::tuple<typename Fields::type*...> columns_{};
+   std::size_t size_ = 0;
+};
+
+
+template <typename... Fields>
+class soa {
+public:
+   static constexpr std::size_t alignment = 64;
+
+   soa() = default;
+
+   explicit soa(std::size_t size) {
+      resize(size);
+   }
+
+   soa(const soa& s) {
+      reserve(s.size_);
+      copy_columns(s, s.size_);
+      size_ = s.size_;
+   }
+
+   soa(soa&& s) noexcept
+      : data_{std::exchange(s.data_, nullptr)}, columns_{std::exchange(s.columns_, {})},
+        size_{std::exchange(s.size_, 0)}, capacity_{std::exchange(s.capacity_, 0)} {
+   }
+
+   soa& operator=(soa s) noexcept {
+      std::swap(data_, s.data_);
+      std::swap(columns_, s.columns_);
+      std::swap(size_, s.size_);
+      std::swap(capacity_, s.capacity_);
+      return *this;
+   }
+
+   ~soa() {
+      ::operator delete(data_, std::align_val_t{alignment});
+   }
+
+   std::size_t size() const noexcept {
+      return size_;
+   }
+
+   bool empty() const noexcept {
+      return size_ == 0;
+   }
+
+   // At least size(), rounded up so that every column ends on a cache line.
+   std::size_t capacity() const noexcept {
+      return capacity_;
+   }
+
+   template <typename F>
+   std::span<typename F::type> get() noexcept {
+      return {std::get<detail::soa_index<F, Fields...>()>(columns_), size_};
+   }
+
+   template <typename F>
+   std::span<const typename F::type> get() const noexcept {
+      return {std::get<detail::soa_index<F, Fields...>()>(columns_), size_};
+   }
+
+   soa_view<Fields...> view() noexcept {
+      return {columns_, size_};
+   }
+
+   soa_view<Fields...> view(std::size_t first, std::size_t count) noexcept {
+      return view().subview(first, count);
+   }
+
+   void push_back(const typename Fields::type&... values) {
+      if(size_ == capacity_) {
+         reserve(std::max<std::size_t>(2 * capacity_, 1));
+      }
+      std::apply([&](auto*... c) { ((c[size_] = values), ...); }, columns_);
+      ++size_;
+   }
+
+   void resize(std::size_t size) {
+      reserve(size);
+      if(size < size_) {
+         clear_columns(size, size_);
+      }
+      size_ = size;
+   }
+
+   void clear() noexcept {
+      clear_columns(0, size_);
+      size_ = 0;
+   }
+
+   void reserve(std::size_t capacity) {
+      if(capacity <= capacity_) {
+         return;
+      }
+      // A whole number of cache lines for the column of the smallest type,
+      // unless even that is larger than a cache line.
+      constexpr std::size_t granule =
+          std::max<std::size_t>(alignment / std::min({sizeof(typename Fields::type)...}), 1);
+      capacity = (capacity + granule - 1) / granule * granule;
+
+      soa s;
+      s.capacity_ = capacity;
+      const std::size_t bytes = (column_bytes<typename Fields::type>(capacity) + ...);
+      s.data_ = static_cast<std::byte*>(::operator new(bytes, std::align_val_t{alignment}));
+      std::memset(s.data_, 0, bytes);
+      std::size_t offset = 0;
+      s.columns_ = {column<typename Fields::type>(s.data_, offset, capacity)...};
+      s.copy_columns(*this, size_);
+      s.size_ = size_;
+      *this = std::move(s);
+   }
+
+private:
+   template <typename T>
+   static constexpr std::size_t column_bytes(std::size_t capacity) noexcept {
+      return (capacity * sizeof(T) + alignment - 1) / alignment * alignment;
+   }
+
+   template <typename T>
+   static T* column(std::byte* data, std::size_t& offset, std::size_t capacity) noexcept {
+      auto* c = reinterpret_cast<T*>(data + offset);
+      offset += column_bytes<T>(capacity);
+      return c;
+   }
+
+   void copy_columns(const soa& s, std::size_t n) noexcept {
+      if(n == 0) {
+         return;
+      }
+      [&]<std::size_t... I>(std::index_sequence<I...>) {
+         (std::memcpy(std::get<I>(columns_), std::get<I>(s.columns_), n * sizeof(typename Fields::type)), ...);
+      }(std::index_sequence_for<Fields...>{});
+   }
+
+   void clear_columns(std::size_t first, std::size_t last) noexcept {
+      if(first < last) {
+         std::apply([&](auto*... c) { (std::fill(c + first, c + last, typename Fields::type{}), ...); }, columns_);
+      }
+   }
+
+   std::byte* data_ = nullptr;
+   std::tuple<typename Fields::type*...> columns_{};
+   std::size_t size_ = 0;
+   std::size_t capacity_ = 0;
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "awaitable_traits.hpp"
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+
+// Bridge from blocking code into coroutines: sync_wait(awaitable) starts the
+// awaitable on the calling thread and blocks, on a condition variable rather
+// than spinning, until it completes wherever it was resumed. Returns the
+// result or rethrows the exception.
+namespace detail {
+
+
+// The event lives on the waiting thread's stack: set() notifies under the
+// lock, so that wait() can not return, and the event go away, before set()
+// is done with it.
+class sync_wait_event {
+public:
+   void set() noexcept {
+      std::lock_guard lock{mutex_};
+      set_ = true;
+      cv_.notify_one();
+   }
+
+   void wait() noexcept {
+      std::unique_lock lock{mutex_};
+      cv_.wait(lock, [this] { return set_; });
+   }
+
+private:
+   std::mutex mutex_;
+   std::condition_variable cv_;
+   bool set_ = false;
+};
+
+
+// Stores by value unless the awaitable hands out an lvalue reference,
+// in which case the referenced object outlives the wait.
+template <typename R>
+using sync_wait_result_t =
+   std::conditional_t<std::is_lvalue_reference_v<R>, R, std::remove_cvref_t<R>>;
+
+
+template <typename R>
+class sync_wait_task {
+public:
+   class promise_type {
+   public:
+      sync_wait_task get_return_object() noexcept {
+         return sync_wait_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+      }
+
+      auto initial_suspend() noexcept {
+         return std::suspend_always{};
+      }
+
+      // Signals the waiting thread from inside the final suspension, once
+      // the frame may safely be destroyed by it.
+      auto final_suspend() noexcept {
+         struct notifier {
+            bool await_ready() const noexcept {
+               return false;
+            }
+
+            void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+               handle.promise().event_->set();
+            }
+
+            void await_resume() const noexcept {
+            }
+         };
+         return notifier{};
+      }
+
+      void unhandled_exception() noexcept {
+         exception_ = std::current_exception();
+      }
+
+      void return_value(R&& value) {
+         if constexpr(std::is_lvalue_reference_v<R>) {
+            value_ = std::addressof(value);
+         } else {
+            value_.emplace(std::move(value));
+         }
+      }
+
+      void start(sync_wait_event& event) {
+         event_ = &event;
+         std::coroutine_handle<promise_type>::from_promise(*this).resume();
+      }
+
+      sync_wait_result_t<R> result() {
+         if(exception_) {
+            std::rethrow_exception(exception_);
+         }
+         if constexpr(std::is_lvalue_reference_v<R>) {
+            return *value_;
+         } else {
+            return std::move(*value_);
+         }
+      }
+
+   private:
+      using storage_type = std::conditional_t<std::is_lvalue_reference_v<R>,
+                                              std::remove_reference_t<R>*,
+                                              std::optional<std::remove_cvref_t<R>>>;
+
+      sync_wait_event* event_ = nullptr;
+      storage_type value_{};
+      std::exception_ptr exception_;
+   };
+
+   explicit sync_wait_task(std::coroutine_handle<promise_type> handle) noexcept : handle_{handle} {
+   }
+
+   sync_wait_task(const sync_wait_task&) = delete;
+   sync_wait_task& operator=(const sync_wait_task&) = delete;
+
+   ~sync_wait_task() {
+      handle_.destroy();
+   }
+
+   promise_type& promise() const noexcept {
+      return handle_.promise();
+   }
+
+private:
+   std::coroutine_handle<promise_type> handle_;
+};
+
+
+template <>
+class sync_wait_task<void> {
+public:
+   class promise_type {
+   public:
+      sync_wait_task get_return_object() noexcept {
+         return sync_wait_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+      }
+
+      auto initial_suspend() noexcept {
+         return std::suspend_always{};
+      }
+
+      auto final_suspend() noexcept {
+         struct notifier {
+            bool await_ready() const noexcept {
+               return false;
+            }
+
+            void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+               handle.promise().event_->set();
+            }
+
+            void await_resume() const noexcept {
+            }
+         };
+         return notifier{};
+      }
+
+      void unhandled_exception() noexcept {
+         exception_ = std::current_exception();
+      }
+
+      void return_void() noexcept {
+      }
+
+      void start(sync_wait_event& event) {
+         event_ = &event;
+         std::coroutine_handle<promise_type>::from_promise(*this).resume();
+      }
+
+      void result() const {
+         if(exception_) {
+            std::rethrow_exception(exception_);
+         }
+      }
+
+   private:
+      sync_wait_event* event_ = nullptr;
+      std::exception_ptr exception_;
+   };
+
+   explicit sync_wait_task(std::coroutine_handle<promise_type> handle) noexcept : handle_{handle} {
+   }
+
+   sync_wait_task(const sync_wait_task&) = delete;
+   sync_wait_task& operator=(const sync_wait_task&) = delete;
+
+   ~sync_wait_task() {
+      handle_.destroy();
+   }
+
+   promise_type& promise() const noexcept {
+      return handle_.promise();
+   }
+
+private:
+   std::coroutine_handle<promise_type> handle_;
+};
+
+
+// The awaitable is taken by reference: it lives in the caller of sync_wait,
+// which does not return before the coroutine has finished.
+template <typename A, typename R = await_result_t<A>>
+   requires(!std::is_void_v<R>)
+sync_wait_task<R> make_sync_wait_task(A&& awaitable) {
+   co_return co_await std::forward<A>(awaitable);
+}
+
+
+template <typename A, typename R = await_result_t<A>>
+   requires std::is_void_v<R>
+sync_wait_task<void> make_sync_wait_task(A&& awaitable) {
+   co_await std::forward<A>(awaitable);
+}
+
+
+}  // namespace detail
+
+
+template <typename A>
+decltype(auto) sync_wait(A&& awaitable) {
+   auto task = detail::make_sync_wait_task(std::forward<A>(awaitable));
+   detail::sync_wait_event event;
+   task.promise().start(event);
+   event.wait();
+   return task.promise().result();
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+
+// Lazily started coroutine with a single awaiter. Unlike CoTask it is not
+// driven by resume() from the outside: awaiting it starts the coroutine and
+// the awaiter is resumed, through symmetric transfer, when it completes.
+// Exceptions escaping the body are rethrown to the awaiter.
+template <typename T = void>
+class task;
+
+
+namespace detail {
+
+
+class task_promise_base {
+public:
+   auto initial_suspend() noexcept {
+      return std::suspend_always{};
+   }
+
+   // Hands control back to the awaiter without growing the stack.
+   auto final_suspend() noexcept {
+      return final_awaiter{};
+   }
+
+   void set_continuation(std::coroutine_handle<> continuation) noexcept {
+      continuation_ = continuation;
+   }
+
+private:
+   struct final_awaiter {
+      bool await_ready() const noexcept {
+         return false;
+      }
+
+      template <typename P>
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept {
+         return handle.promise().continuation_;
+      }
+
+      void await_resume() const noexcept {
+      }
+   };
+
+   std::coroutine_handle<> continuation_ = std::noop_coroutine();
+};
+
+
+template <typename T>
+class task_promise : public task_promise_base {
+public:
+   task<T> get_return_object() noexcept;
+
+   void unhandled_exception() noexcept {
+      result_.template emplace<2>(std::current_exception());
+   }
+
+   template <typename U>
+      requires std::is_convertible_v<U&&, T>
+   void return_value(U&& value) {
+      result_.template emplace<1>(std::forward<U>(value));
+   }
+
+   T& result() & {
+      rethrow_if_exception();
+      return std::get<1>(result_);
+   }
+
+   T&& result() && {
+      rethrow_if_exception();
+      return std::move(std::get<1>(result_));
+   }
+
+private:
+   void rethrow_if_exception() const {
+      if(result_.index() == 2) {
+         std::rethrow_exception(std::get<2>(result_));
+      }
+   }
+
+   std::variant<std::monostate, T, std::exception_ptr> result_;
+};
+
+
+template <>
+class task_promise<void> : public task_promise_base {
+public:
+   task<void> get_return_object() noexcept;
+
+   void unhandled_exception() noexcept {
+      exception_ = std::current_exception();
+   }
+
+   void return_void() noexcept {
+   }
+
+   void result() const {
+      if(exception_) {
+         std::rethrow_exception(exception_);
+      }
+   }
+
+private:
+   std::exception_ptr exception_;
+};
+
+
+}  // namespace detail
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class [[nodiscard]] task {
+public:
+   using promise_type = detail::task_promise<T>;
+   using handle_type = std::coroutine_handle<promise_type>;
+
+   task() noexcept = default;
+
+   explicit task(handle_type handle) noexcept : handle_{handle} {
+   }
+
+   task(const task&) = delete;
+
+   task(task&& t) noexcept : handle_{std::exchange(t.handle_, nullptr)} {
+   }
+
+   task& operator=(const task&) = delete;
+
+   task& operator=(task&& t) noexcept {
+      if(this != &t) {
+         if(handle_) {
+            handle_.destroy();
+         }
+         handle_ = std::exchange(t.handle_, nullptr);
+      }
+      return *this;
+   }
+
+   ~task() {
+      if(handle_) {
+         handle_.destroy();
+      }
+   }
+
+   bool is_ready() const noexcept {
+      return !handle_ || handle_.done();
+   }
+
+   // Awaiting an lvalue task yields T&, awaiting an rvalue yields T&&.
+   auto operator co_await() & noexcept {
+      struct awaiter : awaiter_base {
+         decltype(auto) await_resume() {
+            return this->handle_.promise().result();
+         }
+      };
+      return awaiter{{handle_}};
+   }
+
+   auto operator co_await() && noexcept {
+      struct awaiter : awaiter_base {
+         decltype(auto) await_resume() {
+            return std::move(this->handle_.promise()).result();
+         }
+      };
+      return awaiter{{handle_}};
+   }
+
+private:
+   struct awaiter_base {
+      handle_type handle_;
+
+      bool await_ready() const noexcept {
+         return !handle_ || handle_.done();
+      }
+
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+         handle_.promise().set_continuation(awaiting);
+         return handle_;
+      }
+   };
+
+   handle_type handle_;
+};
+
+
+namespace detail {
+
+
+template <typename T>
+task<T> task_promise<T>::get_return_object() noexcept {
+   return task<T>{std::coroutine_handle<task_promise>::from_promise(*this)};
+}
+
+
+inline task<void> task_promise<void>::get_return_object() noexcept {
+   return task<void>{std::coroutine_handle<task_promise>::from_promise(*this)};
+}
+
+
+}  // namespace detail
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of worker threads resuming coroutine handles in FIFO order.
+// A coroutine moves itself onto the pool with co_await pool.schedule().
+class thread_pool {
+public:
+   explicit thread_pool(unsigned threads = std::thread::hardware_concurrency()) {
+      if(threads == 0) {
+         threads = 1;
+      }
+      workers_.reserve(threads);
+      for(unsigned i = 0; i < threads; ++i) {
+         workers_.emplace_back([this](std::stop_token stop) { run(stop); });
+      }
+   }
+
+   thread_pool(const thread_pool&) = delete;
+   thread_pool& operator=(const thread_pool&) = delete;
+
+   // Drains the queue: workers resume the handles still queued, and those
+   // enqueued meanwhile, and exit once it is empty. Returns when they have.
+   ~thread_pool() {
+      for(auto& w : workers_) {
+         w.request_stop();
+      }
+      cv_.notify_all();
+   }
+
+   std::size_t size() const noexcept {
+      return workers_.size();
+   }
+
+   // Workers waiting for work, as a hint for splitting work. Stale as soon
+   // as it is read.
+   std::size_t idle() const noexcept {
+      return idle_.load(std::memory_order_relaxed);
+   }
+
+   auto schedule() noexcept {
+      struct awaiter {
+         thread_pool& pool_;
+
+         bool await_ready() const noexcept {
+            return false;
+         }
+
+         void await_suspend(std::coroutine_handle<> handle) {
+            pool_.enqueue(handle);
+         }
+
+         void await_resume() const noexcept {
+         }
+      };
+      return awaiter{*this};
+   }
+
+   void enqueue(std::coroutine_handle<> handle) {
+      {
+         std::lock_guard lock{mutex_};
+         queue_.push_back(handle);
+      }
+      cv_.notify_one();
+   }
+
+   // Queues a batch of handles under a single lock acquisition.
+   template <typename It>
+   void enqueue_bulk(It first, It last) {
+      std::size_t n = 0;
+      {
+         std::lock_guard lock{mutex_};
+         for(; first != last; ++first, ++n) {
+            queue_.push_back(*first);
+         }
+      }
+      if(n == 1) {
+         cv_.notify_one();
+      } else if(n > 1) {
+         cv_.notify_all();
+      }
+   }
+
+private:
+   void run(std::stop_token stop) {
+      while(true) {
+         std::coroutine_handle<> handle;
+         {
+            std::unique_lock lock{mutex_};
+            idle_.fetch_add(1, std::memory_order_relaxed);
+            const bool woken = cv_.wait(lock, stop, [this] { return !queue_.empty(); });
+            idle_.fetch_sub(1, std::memory_order_relaxed);
+            if(!woken) {
+               return;
+            }
+            handle = queue_.front();
+            queue_.pop_front();
+         }
+         handle.resume();
+      }
+   }
+
+   std::mutex mutex_;
+   std::condition_variable_any cv_;
+   std::deque<std::coroutine_handle<>> queue_;
+   std::atomic<std::size_t> idle_ = 0;
+   // Last member, so workers are joined before the queue goes away.
+   std::vector<std::jthread> workers_;
+};
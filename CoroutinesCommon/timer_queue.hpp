@@ -0,0 +1,147 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <map>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+
+// Event loop timer: a single thread sleeping until the earliest deadline.
+// Expired timers fire on that thread and are expected to be cheap, e.g.
+// handing a coroutine to the executor, as co_await timers.sleep_for() does.
+// Timers are intrusive nodes that can be cancelled until they fire.
+class timer_queue {
+public:
+   using clock = std::chrono::steady_clock;
+
+   struct node {
+      void (*fire)(node*) noexcept = nullptr;
+      // Guarded by the queue mutex.
+      bool armed_ = false;
+      std::multimap<clock::time_point, node*>::iterator position_;
+   };
+
+   explicit timer_queue(thread_pool& executor) : executor_{executor} {
+      thread_ = std::jthread{[this](std::stop_token stop) { run(stop); }};
+   }
+
+   timer_queue(const timer_queue&) = delete;
+   timer_queue& operator=(const timer_queue&) = delete;
+
+   // Timers still pending at destruction never fire.
+   ~timer_queue() {
+      thread_.request_stop();
+      thread_.join();
+   }
+
+   thread_pool& executor() const noexcept {
+      return executor_;
+   }
+
+   void add(node* n, clock::time_point deadline) {
+      bool earliest;
+      {
+         std::lock_guard lock{mutex_};
+         n->position_ = timers_.emplace(deadline, n);
+         n->armed_ = true;
+         earliest = n->position_ == timers_.begin();
+      }
+      if(earliest) {
+         cv_.notify_one();
+      }
+   }
+
+   // Returns true if the timer was removed before firing. Once it returns
+   // false, the fire function is running or has run.
+   bool cancel(node* n) {
+      std::lock_guard lock{mutex_};
+      if(!n->armed_) {
+         return false;
+      }
+      timers_.erase(n->position_);
+      n->armed_ = false;
+      return true;
+   }
+
+   auto sleep_until(clock::time_point deadline) noexcept {
+      struct awaiter : node {
+         timer_queue& timers_;
+         clock::time_point deadline_;
+         std::coroutine_handle<> handle_;
+
+         awaiter(timer_queue& timers, clock::time_point deadline) noexcept
+            : node{&resume_on_executor, false, {}}, timers_{timers}, deadline_{deadline} {
+         }
+
+         bool await_ready() const noexcept {
+            return deadline_ <= clock::now();
+         }
+
+         void await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+            timers_.add(this, deadline_);
+         }
+
+         void await_resume() const noexcept {
+         }
+
+         static void resume_on_executor(node* n) noexcept {
+            auto* self = static_cast<awaiter*>(n);
+            self->timers_.executor().enqueue(self->handle_);
+         }
+      };
+      return awaiter{*this, deadline};
+   }
+
+   auto sleep_for(clock::duration d) noexcept {
+      return sleep_until(clock::now() + d);
+   }
+
+private:
+   void run(std::stop_token stop) {
+      std::vector<node*> expired;
+      std::unique_lock lock{mutex_};
+      while(!stop.stop_requested()) {
+         if(timers_.empty()) {
+            cv_.wait(lock, stop, [this] { return !timers_.empty(); });
+            continue;
+         }
+
+         auto deadline = timers_.begin()->first;
+         if(deadline > clock::now()) {
+            // Woken up early by a new earliest timer or by stop.
+            cv_.wait_until(lock, stop, deadline, [&] {
+               return timers_.empty() || timers_.begin()->first < deadline;
+            });
+            continue;
+         }
+
+         auto now = clock::now();
+         auto end = timers_.upper_bound(now);
+         for(auto it = timers_.begin(); it != end; ++it) {
+            it->second->armed_ = false;
+            expired.push_back(it->second);
+         }
+         timers_.erase(timers_.begin(), end);
+
+         lock.unlock();
+         for(auto* n : expired) {
+            n->fire(n);
+         }
+         expired.clear();
+         lock.lock();
+      }
+   }
+
+   thread_pool& executor_;
+   std::mutex mutex_;
+   std::condition_variable_any cv_;
+   std::multimap<clock::time_point, node*> timers_;
+   std::jthread thread_;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "task.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// co_await when_all(std::move(tasks)) starts every task and resumes the
+// awaiter once all of them have completed, on the thread that finished
+// last. Yields the results in order (nothing for task<void>) and rethrows
+// the first exception in task order.
+namespace detail {
+
+
+class when_all_counter {
+public:
+   explicit when_all_counter(std::size_t count) noexcept : count_{count + 1} {
+   }
+
+   // The extra count belongs to the awaiter, so that tasks completing while
+   // they are still being started do not resume it too early.
+   bool try_await(std::coroutine_handle<> continuation) noexcept {
+      continuation_ = continuation;
+      return count_.fetch_sub(1, std::memory_order_acq_rel) > 1;
+   }
+
+   void notify_completed() noexcept {
+      if(count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+         continuation_.resume();
+      }
+   }
+
+private:
+   std::atomic<std::size_t> count_;
+   std::coroutine_handle<> continuation_;
+};
+
+
+// Wrapper coroutine that reports completion of one task to the counter.
+class when_all_task {
+public:
+   class promise_type {
+   public:
+      when_all_task get_return_object() noexcept {
+         return when_all_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+      }
+
+      auto initial_suspend() noexcept {
+         return std::suspend_always{};
+      }
+
+      auto final_suspend() noexcept {
+         struct notifier {
+            bool await_ready() const noexcept {
+               return false;
+            }
+
+            void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+               handle.promise().counter_->notify_completed();
+            }
+
+            void await_resume() const noexcept {
+            }
+         };
+         return notifier{};
+      }
+
+      // Exceptions stay in the wrapped task and are rethrown from there.
+      void unhandled_exception() noexcept {
+      }
+
+      void return_void() noexcept {
+      }
+
+      when_all_counter* counter_ = nullptr;
+   };
+
+   explicit when_all_task(std::coroutine_handle<promise_type> handle) noexcept : handle_{handle} {
+   }
+
+   when_all_task(when_all_task&& t) noexcept : handle_{std::exchange(t.handle_, nullptr)} {
+   }
+
+   ~when_all_task() {
+      if(handle_) {
+         handle_.destroy();
+      }
+   }
+
+   void start(when_all_counter& counter) noexcept {
+      handle_.promise().counter_ = &counter;
+      handle_.resume();
+   }
+
+private:
+   std::coroutine_handle<promise_type> handle_;
+};
+
+
+template <typename T>
+when_all_task make_when_all_task(task<T>& t) {
+   co_await t;
+}
+
+
+}  // namespace detail
+
+
+template <typename T>
+task<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> when_all(std::vector<task<T>> tasks) {
+   detail::when_all_counter counter{tasks.size()};
+   std::vector<detail::when_all_task> wrappers;
+   wrappers.reserve(tasks.size());
+   for(auto& t : tasks) {
+      wrappers.push_back(detail::make_when_all_task(t));
+   }
+
+   struct awaiter {
+      detail::when_all_counter& counter_;
+      std::vector<detail::when_all_task>& wrappers_;
+
+      bool await_ready() const noexcept {
+         return false;
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept {
+         for(auto& w : wrappers_) {
+            w.start(counter_);
+         }
+         return counter_.try_await(handle);
+      }
+
+      void await_resume() const noexcept {
+      }
+   };
+   co_await awaiter{counter, wrappers};
+
+   if constexpr(std::is_void_v<T>) {
+      for(auto& t : tasks) {
+         co_await t;
+      }
+   } else {
+      std::vector<T> results;
+      results.reserve(tasks.size());
+      for(auto& t : tasks) {
+         results.push_back(std::move(co_await t));
+      }
+      co_return results;
+   }
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+
+// Typed name of a product, resolved once by a whiteboard_schema. On a
+// whiteboard it is an index into arrays, not a string to hash.
+template <typename T>
+struct product_key {
+   std::uint32_t id;
+};
+
+
+// The products an event may hold: names, types and places in the storage of
+// a whiteboard. Products are declared at configuration time, before any
+// whiteboard of the schema exists; the schema must outlive its whiteboards.
+class whiteboard_schema {
+public:
+   // Declaring a name again with the same type returns the same key.
+   template <typename T>
+   product_key<T> declare(std::string_view name) {
+      static_assert(std::is_nothrow_destructible_v<T>);
+      if(auto i = find(name); i < products_.size()) {
+         if(*products_[i].type != typeid(T)) {
+            throw std::invalid_argument{"whiteboard_schema: " + std::string{name} + " declared with another type"};
+         }
+         return {std::uint32_t(i)};
+      }
+      const auto offset = (size_ + alignof(T) - 1) / alignof(T) * alignof(T);
+      products_.push_back({std::string{name}, &typeid(T), offset,
+                           [](void* p) noexcept { std::destroy_at(static_cast<T*>(p)); }});
+      size_ = offset + sizeof(T);
+      alignment_ = std::max(alignment_, alignof(T));
+      return {std::uint32_t(products_.size() - 1)};
+   }
+
+   // Key of a declared product.
+   template <typename T>
+   product_key<T> key(std::string_view name) const {
+      const auto i = find(name);
+      if(i == products_.size() || *products_[i].type != typeid(T)) {
+         throw std::out_of_range{"whiteboard_schema: no product " + std::string{name} + " of this type"};
+      }
+      return {std::uint32_t(i)};
+   }
+
+   std::size_t size() const noexcept {
+      return products_.size();
+   }
+
+   const std::string& name(std::uint32_t id) const {
+      return products_.at(id).name;
+   }
+
+   // Bytes of product storage of a whiteboard.
+   std::size_t storage_size() const noexcept {
+      return size_;
+   }
+
+private:
+   friend class whiteboard;
+
+   struct Product {
+      std::string name;
+      const std::type_info* type;
+      std::size_t offset;
+      void (*destroy)(void*) noexcept;
+   };
+
+   std::size_t find(std::string_view name) const noexcept {
+      return std::size_t(std::ranges::find(products_, name, &Product::name) - products_.begin());
+   }
+
+   std::vector<Product> products_;
+   std::size_t size_ = 0;
+   std::size_t alignment_ = 64;  // slots do not share cache lines
+};
+
+
+// Products of one event slot. Producers put() a product once, consumers
+// co_await get() it, and suspend until it is put. Each product is an array
+// index: its value lives at a fixed offset of one block allocated with the
+// whiteboard, a bit of a per-slot bitset says whether it is ready, and a
+// lock-free stack holds the coroutines waiting for it. put() resumes the
+// waiters inline, in the order they came. Products of a slot may be put and
+// read from any threads; clear() recycles the slot for the next event once
+// its products are no longer used.
+class whiteboard {
+public:
+   explicit whiteboard(const whiteboard_schema& schema)
+      : schema_{&schema},
+        size_{schema.size()},
+        storage_{static_cast<std::byte*>(::operator new(std::max<std::size_t>(schema.storage_size(), 1),
+                                                          std::align_val_t{schema.alignment_}))},
+        ready_{std::make_unique<std::atomic<std::uint64_t>[]>((size_ + 63) / 64)},
+        waiters_{std::make_unique<std::atomic<void*>[]>(size_)} {
+   }
+
+   whiteboard(const whiteboard&) = delete;
+   whiteboard& operator=(const whiteboard&) = delete;
+
+   ~whiteboard() {
+      clear();
+      ::operator delete(storage_, std::align_val_t{schema_->alignment_});
+   }
+
+   // Constructs the product from args and wakes its waiters. A product has
+   // a single producer; putting it twice throws.
+   template <typename T, typename... Args>
+   const T& put(product_key<T> key, Args&&... args) {
+      assert(key.id < size_);
+      if(ready(key.id)) {
+         throw std::logic_error{"whiteboard: " + schema_->name(key.id) + " put twice"};
+      }
+      T* value = std::construct_at(address<T>(key.id), std::forward<Args>(args)...);
+      ready_[key.id / 64].fetch_or(std::uint64_t{1} << key.id % 64, std::memory_order_release);
+      auto* w = static_cast<waiter*>(waiters_[key.id].exchange(ready_value(), std::memory_order_acq_rel));
+      // The stack is newest first.
+      waiter* fifo = nullptr;
+      while(w) {
+         auto* next = w->next_;
+         w->next_ = fifo;
+         fifo = w;
+         w = next;
+      }
+      while(fifo) {
+         // Read next_ before resuming, the awaiter may go away right after.
+         auto* next = fifo->next_;
+         fifo->continuation_.resume();
+         fifo = next;
+      }
+      return *value;
+   }
+
+   // co_await get(key) gives a const reference to the product, valid until
+   // clear().
+   template <typename T>
+   auto get(product_key<T> key) noexcept {
+      struct awaiter : waiter {
+         whiteboard& board_;
+         std::uint32_t id_;
+
+         awaiter(whiteboard& board, std::uint32_t id) noexcept : board_{board}, id_{id} {
+         }
+
+         bool await_ready() const noexcept {
+            return board_.ready(id_);
+         }
+
+         bool await_suspend(std::coroutine_handle<> handle) noexcept {
+            this->continuation_ = handle;
+            auto& head = board_.waiters_[id_];
+            void* old = head.load(std::memory_order_acquire);
+            do {
+               if(old == board_.ready_value()) {
+                  return false;
+               }
+               this->next_ = static_cast<waiter*>(old);
+            } while(!head.compare_exchange_weak(old, static_cast<waiter*>(this), std::memory_order_release,
+                                                std::memory_order_acquire));
+            return true;
+         }
+
+         const T& await_resume() const noexcept {
+            return *board_.address<T>(id_);
+         }
+      };
+      assert(key.id < size_);
+      return awaiter{*this, key.id};
+   }
+
+   // The product if it is ready, without waiting.
+   template <typename T>
+   const T* try_get(product_key<T> key) const noexcept {
+      assert(key.id < size_);
+      return ready(key.id) ? address<T>(key.id) : nullptr;
+   }
+
+   bool ready(std::uint32_t id) const noexcept {
+      return ready_[id / 64].load(std::memory_order_acquire) >> id % 64 & 1;
+   }
+
+   // Products put since the last clear().
+   std::size_t count() const noexcept {
+      std::size_t n = 0;
+      for(std::size_t w = 0; w < (size_ + 63) / 64; ++w) {
+         n += std::size_t(std::popcount(ready_[w].load(std::memory_order_acquire)));
+      }
+      return n;
+   }
+
+   // Destroys the products. Nobody may wait for or put a product meanwhile.
+   void clear() noexcept {
+      for(std::size_t w = 0; w < (size_ + 63) / 64; ++w) {
+         for(auto bits = ready_[w].exchange(0, std::memory_order_acquire); bits; bits &= bits - 1) {
+            const auto id = w * 64 + std::size_t(std::countr_zero(bits));
+            schema_->products_[id].destroy(storage_ + schema_->products_[id].offset);
+            waiters_[id].store(nullptr, std::memory_order_relaxed);
+         }
+      }
+      assert(std::all_of(waiters_.get(), waiters_.get() + size_, [](auto& w) { return !w.load(); }));
+   }
+
+private:
+   struct waiter {
+      std::coroutine_handle<> continuation_;
+      waiter* next_ = nullptr;
+   };
+
+   template <typename T>
+   T* address(std::uint32_t id) const noexcept {
+      return std::launder(reinterpret_cast<T*>(storage_ + schema_->products_[id].offset));
+   }
+
+   // Waiter stack value of a product that is ready.
+   void* ready_value() const noexcept {
+      return const_cast<whiteboard*>(this);
+   }
+
+   const whiteboard_schema* schema_;
+   std::size_t size_;
+   std::byte* storage_;
+   std::unique_ptr<std::atomic<std::uint64_t>[]> ready_;
+   std::unique_ptr<std::atomic<void*>[]> waiters_;
+};
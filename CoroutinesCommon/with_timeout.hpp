@@ -0,0 +1,173 @@
+#pragma once
+
+#include "awaitable_traits.hpp"
+#include "task.hpp"
+#include "timer_queue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+
+// co_await with_timeout(timers, awaitable, timeout) races the awaitable
+// against a timer. It yields std::optional<T> (bool for void awaitables),
+// empty if the timeout expired first; exceptions of the awaitable are
+// rethrown if it finished first.
+//
+// The loser is cancelled: a timer that did not fire is removed from the
+// queue, and an awaitable that did not finish is detached and its frame
+// freed whenever it completes. Passing a callable taking a std::stop_token
+// instead of an awaitable lets the operation see the timeout as a stop
+// request and complete early.
+template <typename R>
+using timeout_result_t = std::conditional_t<std::is_void_v<R>, bool, std::optional<std::remove_cvref_t<R>>>;
+
+
+namespace detail {
+
+
+template <typename R>
+struct timeout_state : timer_queue::node {
+   enum : int { pending, completed, timed_out };
+
+   std::atomic<int> winner{pending};
+   std::coroutine_handle<> continuation;
+   timer_queue* timers = nullptr;
+   // The armed timer owns a reference, dropped when it fires or is cancelled.
+   std::shared_ptr<timeout_state> timer_ref;
+   std::stop_source stop;
+   std::conditional_t<std::is_void_v<R>, bool, std::optional<std::remove_cvref_t<R>>> value{};
+   std::exception_ptr exception;
+
+   static void on_timeout(timer_queue::node* n) noexcept {
+      auto* self = static_cast<timeout_state*>(n);
+      auto keep_alive = std::move(self->timer_ref);
+      int expected = pending;
+      if(self->winner.compare_exchange_strong(expected, timed_out, std::memory_order_acq_rel)) {
+         self->stop.request_stop();
+         self->timers->executor().enqueue(self->continuation);
+      }
+   }
+
+   void on_completed() noexcept {
+      int expected = pending;
+      if(winner.compare_exchange_strong(expected, completed, std::memory_order_acq_rel)) {
+         if(timers->cancel(this)) {
+            timer_ref.reset();
+         }
+         continuation.resume();
+      }
+   }
+};
+
+
+// Fire-and-forget coroutine awaiting the operation; frees its own frame.
+struct timeout_runner {
+   struct promise_type {
+      timeout_runner get_return_object() noexcept {
+         return {};
+      }
+
+      auto initial_suspend() noexcept {
+         return std::suspend_never{};
+      }
+
+      auto final_suspend() noexcept {
+         return std::suspend_never{};
+      }
+
+      void unhandled_exception() noexcept {
+         std::terminate();
+      }
+
+      void return_void() noexcept {
+      }
+   };
+};
+
+
+template <typename R, typename A>
+timeout_runner run_with_timeout(std::shared_ptr<timeout_state<R>> state, A awaitable) {
+   try {
+      if constexpr(std::is_void_v<R>) {
+         co_await std::move(awaitable);
+         state->value = true;
+      } else {
+         state->value.emplace(co_await std::move(awaitable));
+      }
+   } catch(...) {
+      state->exception = std::current_exception();
+   }
+   state->on_completed();
+}
+
+
+template <typename R, typename A>
+struct timeout_awaiter {
+   std::shared_ptr<timeout_state<R>> state_;
+   A awaitable_;
+   timer_queue::clock::duration timeout_;
+
+   bool await_ready() const noexcept {
+      return false;
+   }
+
+   void await_suspend(std::coroutine_handle<> handle) {
+      // Either side may resume the awaiting coroutine, and destroy this
+      // awaiter, as soon as the timer is armed: only locals from here on.
+      auto state = state_;
+      auto awaitable = std::move(awaitable_);
+      state->continuation = handle;
+      state->timer_ref = state;
+      state->timers->add(state.get(), timer_queue::clock::now() + timeout_);
+      run_with_timeout<R>(std::move(state), std::move(awaitable));
+   }
+
+   timeout_result_t<R> await_resume() {
+      if(state_->winner.load(std::memory_order_acquire) == timeout_state<R>::timed_out) {
+         return timeout_result_t<R>{};
+      }
+      if(state_->exception) {
+         std::rethrow_exception(state_->exception);
+      }
+      return std::move(state_->value);
+   }
+};
+
+
+}  // namespace detail
+
+
+template <typename A, typename R = await_result_t<A>>
+   requires(!std::invocable<A, std::stop_token>)
+task<timeout_result_t<R>> with_timeout(timer_queue& timers, A awaitable, timer_queue::clock::duration timeout) {
+   auto state = std::make_shared<detail::timeout_state<R>>();
+   state->fire = &detail::timeout_state<R>::on_timeout;
+   state->timers = &timers;
+   // Named rather than a temporary inside co_return: GCC 12 destroys such
+   // temporaries twice.
+   detail::timeout_awaiter<R, A> race{std::move(state), std::move(awaitable), timeout};
+   co_return co_await race;
+}
+
+
+template <typename F>
+   requires std::invocable<F, std::stop_token>
+auto with_timeout(timer_queue& timers, F make_awaitable, timer_queue::clock::duration timeout)
+   -> task<timeout_result_t<await_result_t<std::invoke_result_t<F, std::stop_token>>>> {
+   using A = std::invoke_result_t<F, std::stop_token>;
+   using R = await_result_t<A>;
+   auto state = std::make_shared<detail::timeout_state<R>>();
+   state->fire = &detail::timeout_state<R>::on_timeout;
+   state->timers = &timers;
+   detail::timeout_awaiter<R, A> race{state, make_awaitable(state->stop.get_token()), timeout};
+   state.reset();
+   co_return co_await race;
+}
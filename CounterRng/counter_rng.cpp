@@ -0,0 +1,223 @@
+#include <version>
+
+
+#ifdef __cpp_lib_generator
+#include "counter_rng.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <generator>
+#include <iomanip>
+#include <iostream>
+#include <numbers>
+#include <numeric>
+#include <random>
+#include <ranges>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Known-answer values of the reference implementation.
+bool known_answers() {
+   return philox4x32::bijection({0, 0, 0, 0}, {0, 0}) ==
+             philox4x32::block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8} &&
+          philox4x32::bijection({~0u, ~0u, ~0u, ~0u}, {~0u, ~0u}) ==
+             philox4x32::block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd} &&
+          philox4x32::bijection({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}) ==
+             philox4x32::block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1} &&
+          threefry4x64::bijection({0, 0, 0, 0}, {0, 0, 0, 0}) ==
+             threefry4x64::block{0x09218ebde6c85537, 0x55941f5266d86105, 0x4bd25e16282434dc,
+                                 0xee29ec846bd2e40b} &&
+          threefry4x64::bijection({~0ul, ~0ul, ~0ul, ~0ul}, {~0ul, ~0ul, ~0ul, ~0ul}) ==
+             threefry4x64::block{0x29c24097942bba1b, 0x0371bbfb0f6f4e11, 0x3c231ffa33f83a1c,
+                                 0xcd29113fde32d168};
+}
+
+
+// Millions of numbers per second drawn by f(n), which returns a checksum.
+template <typename F>
+double rate(std::uint64_t n, F f) {
+   auto t0 = std::chrono::steady_clock::now();
+   volatile auto sink = f(n);
+   (void)sink;
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   return double(n) / dt.count() / 1e6;
+}
+
+
+template <typename Rng>
+std::uint64_t one_by_one(Rng rng, std::uint64_t n) {
+   std::uint64_t sum = 0;
+   for(std::uint64_t i = 0; i < n; ++i) {
+      sum += rng();
+   }
+   return sum;
+}
+
+
+template <typename Engine>
+std::uint64_t from_generator(std::uint64_t n) {
+   std::uint64_t sum = 0;
+   for(auto x : random_numbers(counter_rng<Engine>{1, 2, 3}) | std::views::take(n)) {
+      sum += x;
+   }
+   return sum;
+}
+
+
+template <typename Engine>
+std::uint64_t in_bulk(std::uint64_t n, std::uint64_t event = 2) {
+   counter_rng<Engine> rng{1, event, 3};
+   std::vector<typename Engine::word> buffer(4096);
+   std::uint64_t sum = 0;
+   for(std::uint64_t done = 0; done < n; done += buffer.size()) {
+      rng.fill(buffer);
+      sum += buffer[0];
+   }
+   return sum;
+}
+
+
+// Particle gun: every event shoots particles from a few guns, each gun
+// drawing from its own stream (seed, event, gun). Returns the summed momentum
+// components of the event.
+struct Momentum {
+   double px = 0, py = 0, pz = 0;
+
+   bool operator==(const Momentum&) const = default;
+};
+
+
+constexpr unsigned guns = 4;
+constexpr std::size_t particles_per_gun = 250;
+
+
+Momentum shoot(std::uint64_t seed, std::uint64_t event) {
+   Momentum p;
+   std::vector<double> u(3 * particles_per_gun);
+   for(unsigned gun = 0; gun < guns; ++gun) {
+      threefry_rng{seed, event, gun}.fill_uniform(std::span{u});
+      for(std::size_t i = 0; i < u.size(); i += 3) {
+         const double pt = -10. * std::log1p(-u[i]);
+         const double eta = -2.5 + 5. * u[i + 1];
+         const double phi = 2. * std::numbers::pi * u[i + 2];
+         p.px += pt * std::cos(phi);
+         p.py += pt * std::sin(phi);
+         p.pz += pt * std::sinh(eta);
+      }
+   }
+   return p;
+}
+
+
+task<> simulate(thread_pool& pool, std::uint64_t seed, std::uint64_t event, Momentum& result) {
+   co_await pool.schedule();
+   result = shoot(seed, event);
+}
+
+
+// Bulk and one-by-one draws see the same stream, from any position. The
+// bulk fill goes through the wide generate of the engine.
+template <typename Rng>
+bool bulk_matches_one_by_one() {
+   Rng a{7, 8, 9}, b{7, 8, 9};
+   std::vector<typename Rng::result_type> bulk(1001);
+   a.discard(3);
+   a.fill(bulk);
+   b.discard(3);
+   return std::ranges::all_of(bulk, [&](auto x) { return x == b(); });
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::uint64_t n = argc > 1 ? std::stoull(argv[1]) : 1 << 26;
+   const std::uint64_t events = argc > 2 ? std::stoull(argv[2]) : 20000;
+   const std::uint64_t seed = 12345;
+
+   if(!known_answers()) {
+      std::cerr << "known-answer test failed\n";
+      return EXIT_FAILURE;
+   }
+   if(!bulk_matches_one_by_one<philox_rng>() || !bulk_matches_one_by_one<threefry_rng>()) {
+      std::cerr << "bulk and one-by-one streams differ\n";
+      return EXIT_FAILURE;
+   }
+
+   std::cout << n << " random numbers per measurement, M numbers/s\n";
+   std::cout << std::setw(24) << "" << std::setw(12) << "mt19937" << std::setw(12) << "philox" << std::setw(12)
+             << "threefry" << '\n';
+   std::cout << std::fixed << std::setprecision(0);
+   std::cout << std::setw(24) << "one by one" << std::setw(12)
+             << rate(n, [](auto n) { return one_by_one(std::mt19937{1}, n); }) << std::setw(12)
+             << rate(n, [](auto n) { return one_by_one(philox_rng{1, 2, 3}, n); }) << std::setw(12)
+             << rate(n, [](auto n) { return one_by_one(threefry_rng{1, 2, 3}, n); }) << '\n';
+   std::cout << std::setw(24) << "std::generator" << std::setw(12) << "" << std::setw(12)
+             << rate(n, from_generator<philox4x32>) << std::setw(12) << rate(n, from_generator<threefry4x64>)
+             << '\n';
+   std::cout << std::setw(24) << "bulk fill" << std::setw(12) << "" << std::setw(12)
+             << rate(n, [](auto n) { return in_bulk<philox4x32>(n); }) << std::setw(12)
+             << rate(n, [](auto n) { return in_bulk<threefry4x64>(n); }) << '\n';
+
+   for(unsigned threads = 2; threads <= std::max(4u, std::thread::hardware_concurrency()); threads *= 2) {
+      auto bulk = [&](auto engine) {
+         return rate(n * threads, [&](auto) {
+            std::vector<std::jthread> workers;
+            for(unsigned t = 0; t < threads; ++t) {
+               workers.emplace_back([&, t] { in_bulk<decltype(engine)>(n, t); });
+            }
+            return 0;
+         });
+      };
+      std::cout << std::setw(24) << "bulk fill, " + std::to_string(threads) + " threads" << std::setw(12) << ""
+                << std::setw(12) << bulk(philox4x32{}) << std::setw(12) << bulk(threefry4x64{}) << '\n';
+   }
+
+   // The particle gun, serially and with events run in random order on a pool.
+   std::vector<Momentum> serial(events), parallel(events);
+   auto t0 = std::chrono::steady_clock::now();
+   for(std::uint64_t e = 0; e < events; ++e) {
+      serial[e] = shoot(seed, e);
+   }
+   std::chrono::duration<double> serial_time = std::chrono::steady_clock::now() - t0;
+
+   std::vector<std::uint64_t> order(events);
+   std::iota(order.begin(), order.end(), 0);
+   std::shuffle(order.begin(), order.end(), std::mt19937_64{std::random_device{}()});
+   thread_pool pool;
+   std::vector<task<>> tasks;
+   for(auto e : order) {
+      tasks.push_back(simulate(pool, seed, e, parallel[e]));
+   }
+   t0 = std::chrono::steady_clock::now();
+   sync_wait(when_all(std::move(tasks)));
+   std::chrono::duration<double> parallel_time = std::chrono::steady_clock::now() - t0;
+
+   std::cout << "\nparticle gun, " << guns << " x " << particles_per_gun << " particles per event\n";
+   std::cout << std::setw(24) << "serial" << std::setw(12) << double(events) / serial_time.count() << " events/s\n";
+   std::cout << std::setw(24) << std::to_string(pool.size()) + " threads, shuffled" << std::setw(12)
+             << double(events) / parallel_time.count() << " events/s\n";
+
+   if(serial != parallel) {
+      std::cerr << "events differ between serial and parallel runs\n";
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
+
+
+#else
+
+
+#error std::generator IS NOT SUPPORTED
+
+
+#endif
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <experimental/simd>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <utility>
+#include <version>
+
+#ifdef __cpp_lib_generator
+#include <generator>
+#endif
+
+
+// Counter-based random number generators: the n-th block of random words of a
+// stream is a keyed bijection of the counter n, so any part of any stream is
+// computed directly, without state carried from one number to the next.
+// Streams are named by (seed, event, task). The numbers an event or task
+// draws are the same whatever thread runs it and in whatever order, which
+// makes parallel simulations reproducible.
+//
+// Philox4x32-10 and Threefry4x64-20 as specified by Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3" (SC11), with the reference known-answer
+// values.
+struct philox4x32 {
+   using word = std::uint32_t;
+   using block = std::array<word, 4>;
+   using key_type = std::array<word, 2>;
+   static constexpr std::size_t words = 4;
+
+   static block bijection(block c, key_type k) noexcept {
+      for(int round = 0; round < 10; ++round) {
+         if(round > 0) {
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+         }
+         const std::uint64_t p0 = std::uint64_t{0xD2511F53} * c[0];
+         const std::uint64_t p1 = std::uint64_t{0xCD9E8D57} * c[2];
+         c = {word(p1 >> 32) ^ c[1] ^ k[0], word(p1), word(p0 >> 32) ^ c[3] ^ k[1], word(p0)};
+      }
+      return c;
+   }
+
+   // The counter holds the block index and the lower 32 bits of event and
+   // task, the key the seed.
+   static block generate(std::uint64_t seed, std::uint64_t event, std::uint64_t task, std::uint64_t index) noexcept {
+      return bijection({word(index), word(index >> 32), word(event), word(task)}, {word(seed), word(seed >> 32)});
+   }
+
+   // Blocks first, first + 1, ... into out. Block by block: std::experimental::simd
+   // has no 32 x 32 -> 64 bit multiplication, and multiplying 64-bit lanes
+   // is slower than the scalar multiplications.
+   static void generate(std::uint64_t seed, std::uint64_t event, std::uint64_t task, std::uint64_t first,
+                        std::size_t blocks, word* out) noexcept {
+      for(std::size_t b = 0; b < blocks; ++b, out += words) {
+         const auto r = generate(seed, event, task, first + b);
+         out[0] = r[0];
+         out[1] = r[1];
+         out[2] = r[2];
+         out[3] = r[3];
+      }
+   }
+};
+
+
+struct threefry4x64 {
+   using word = std::uint64_t;
+   using block = std::array<word, 4>;
+   using key_type = std::array<word, 4>;
+   static constexpr std::size_t words = 4;
+
+   static constexpr int rotations[8][2] = {{14, 16}, {52, 57}, {23, 40}, {5, 37},
+                                           {25, 33}, {46, 12}, {58, 22}, {32, 32}};
+
+   template <typename W>
+   static void rounds(W& x0, W& x1, W& x2, W& x3, const std::array<word, 5>& ks) noexcept {
+      x0 += ks[0];
+      x1 += ks[1];
+      x2 += ks[2];
+      x3 += ks[3];
+      // Unrolled, for rotations by constants.
+      [&]<int... R>(std::integer_sequence<int, R...>) {
+         (round<R>(x0, x1, x2, x3, ks), ...);
+      }(std::make_integer_sequence<int, 20>{});
+   }
+
+   // Mixes (0, 1) and (2, 3) in even rounds, (0, 3) and (2, 1) in odd ones, and
+   // injects the key every four rounds.
+   template <int R, typename W>
+   static void round(W& x0, W& x1, W& x2, W& x3, const std::array<word, 5>& ks) noexcept {
+      if constexpr(R % 2 == 0) {
+         mix<rotations[R % 8][0]>(x0, x1);
+         mix<rotations[R % 8][1]>(x2, x3);
+      } else {
+         mix<rotations[R % 8][0]>(x0, x3);
+         mix<rotations[R % 8][1]>(x2, x1);
+      }
+      if constexpr(R % 4 == 3) {
+         constexpr std::size_t s = R / 4 + 1;
+         x0 += ks[s % 5];
+         x1 += ks[(s + 1) % 5];
+         x2 += ks[(s + 2) % 5];
+         x3 += ks[(s + 3) % 5] + s;
+      }
+   }
+
+   template <int Rotation, typename W>
+   static void mix(W& a, W& b) noexcept {
+      a += b;
+      b = W(b << Rotation) | W(b >> (64 - Rotation));
+      b ^= a;
+   }
+
+   static std::array<word, 5> schedule(const key_type& k) noexcept {
+      return {k[0], k[1], k[2], k[3], 0x1BD11BDAA9FC1A22 ^ k[0] ^ k[1] ^ k[2] ^ k[3]};
+   }
+
+   static block bijection(block c, const key_type& k) noexcept {
+      rounds(c[0], c[1], c[2], c[3], schedule(k));
+      return c;
+   }
+
+   // The counter holds the block index, event and task, the key the seed.
+   static block generate(std::uint64_t seed, std::uint64_t event, std::uint64_t task, std::uint64_t index) noexcept {
+      return bijection({index, event, task, 0}, {seed, 0, 0, 0});
+   }
+
+   // Blocks first, first + 1, ... into out, L at a time in vector lanes.
+   template <std::size_t L = 8>
+   static void generate(std::uint64_t seed, std::uint64_t event, std::uint64_t task, std::uint64_t first,
+                        std::size_t blocks, word* out) noexcept {
+      using V = std::experimental::fixed_size_simd<std::uint64_t, L>;
+      const V lane([](auto i) { return std::uint64_t(i); });
+      const auto ks = schedule({seed, 0, 0, 0});
+      std::size_t b = 0;
+      for(; b + L <= blocks; b += L) {
+         V x0 = lane + (first + b), x1 = event, x2 = task, x3 = 0;
+         rounds(x0, x1, x2, x3, ks);
+         for(std::size_t i = 0; i < L; ++i, out += words) {
+            out[0] = x0[i];
+            out[1] = x1[i];
+            out[2] = x2[i];
+            out[3] = x3[i];
+         }
+      }
+      for(; b < blocks; ++b, out += words) {
+         const auto r = generate(seed, event, task, first + b);
+         out[0] = r[0];
+         out[1] = r[1];
+         out[2] = r[2];
+         out[3] = r[3];
+      }
+   }
+};
+
+
+// Random stream (seed, event, task) of an Engine, a UniformRandomBitGenerator
+// for the standard distributions. fill() produces the next numbers of the
+// stream in bulk.
+template <typename Engine>
+class counter_rng {
+public:
+   using result_type = typename Engine::word;
+
+   counter_rng(std::uint64_t seed, std::uint64_t event, std::uint64_t task) noexcept
+      : seed_{seed}, event_{event}, task_{task} {
+   }
+
+   static constexpr result_type min() noexcept {
+      return 0;
+   }
+
+   static constexpr result_type max() noexcept {
+      return std::numeric_limits<result_type>::max();
+   }
+
+   result_type operator()() noexcept {
+      if(position_ == Engine::words) {
+         block_ = Engine::generate(seed_, event_, task_, index_++);
+         position_ = 0;
+      }
+      return block_[position_++];
+   }
+
+   // Position in the stream, in numbers.
+   std::uint64_t position() const noexcept {
+      return index_ * Engine::words - (Engine::words - position_);
+   }
+
+   void discard(std::uint64_t n) noexcept {
+      seek(position() + n);
+   }
+
+   void seek(std::uint64_t position) noexcept {
+      index_ = position / Engine::words;
+      position_ = Engine::words;
+      for(auto i = position % Engine::words; i > 0; --i) {
+         (*this)();
+      }
+   }
+
+   void fill(std::span<result_type> out) noexcept {
+      std::size_t i = 0;
+      for(; i < out.size() && position_ < Engine::words; ++i) {
+         out[i] = block_[position_++];
+      }
+      const std::size_t blocks = (out.size() - i) / Engine::words;
+      Engine::generate(seed_, event_, task_, index_, blocks, out.data() + i);
+      index_ += blocks;
+      for(i += blocks * Engine::words; i < out.size(); ++i) {
+         out[i] = (*this)();
+      }
+   }
+
+   // Uniform in [0, 1), from the top bits of one number each.
+   template <std::floating_point F>
+   void fill_uniform(std::span<F> out) noexcept {
+      result_type bits[256];
+      for(std::size_t i = 0; i < out.size(); i += std::size(bits)) {
+         const auto n = std::min(std::size(bits), out.size() - i);
+         fill(std::span{bits, n});
+         std::transform(bits, bits + n, out.begin() + std::ptrdiff_t(i), to_uniform<F>);
+      }
+   }
+
+   template <std::floating_point F>
+   static F to_uniform(result_type x) noexcept {
+      constexpr int digits = std::min(std::numeric_limits<F>::digits, std::numeric_limits<result_type>::digits);
+      return F(x >> (std::numeric_limits<result_type>::digits - digits)) *
+             (F(1) / F(std::uint64_t{1} << digits));
+   }
+
+private:
+   std::uint64_t seed_;
+   std::uint64_t event_;
+   std::uint64_t task_;
+   std::uint64_t index_ = 0;
+   typename Engine::block block_{};
+   std::size_t position_ = Engine::words;
+};
+
+
+using philox_rng = counter_rng<philox4x32>;
+using threefry_rng = counter_rng<threefry4x64>;
+
+
+#ifdef __cpp_lib_generator
+// The stream as an endless generator, to be cut with std::views::take.
+template <typename Engine>
+std::generator<typename Engine::word> random_numbers(counter_rng<Engine> rng) {
+   while(true) {
+      co_yield rng();
+   }
+}
+
+
+template <std::floating_point F, typename Engine>
+std::generator<F> uniforms(counter_rng<Engine> rng) {
+   while(true) {
+      co_yield counter_rng<Engine>::template to_uniform<F>(rng());
+   }
+}
+#endif
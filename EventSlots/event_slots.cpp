@@ -0,0 +1,133 @@
+#include "event_loop.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "whiteboard.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+
+constexpr std::size_t algorithms = 4;
+
+
+struct Products {
+   product_key<std::pmr::vector<float>> raw;
+   std::vector<product_key<double>> reco;
+};
+
+
+// Unpacks the raw data of the event into its arena.
+task<> unpack(event_slot& slot, const Products& p, std::size_t hits) {
+   std::pmr::vector<float> raw(hits, slot.arena());
+   auto x = std::uint32_t(slot.event() * 2654435761u + 1);
+   for(auto& h : raw) {
+      x = x * 1664525u + 1013904223u;
+      h = float(x >> 8) * 0x1p-24f;
+   }
+   slot.board().put(p.raw, std::move(raw));
+   co_return;
+}
+
+
+// Waits for the raw data, then works on it on the pool.
+task<> reconstruct(thread_pool& pool, event_slot& slot, const Products& p, std::size_t i) {
+   const auto& raw = co_await slot.board().get(p.raw);
+   co_await pool.schedule();
+   double sum = 0;
+   for(auto h : raw) {
+      sum += std::sqrt(h * float(i + 1));
+   }
+   slot.board().put(p.reco[i], sum);
+}
+
+
+task<> summarize(event_slot& slot, const Products& p, std::vector<double>& totals) {
+   double total = 0;
+   for(auto k : p.reco) {
+      total += co_await slot.board().get(k);
+   }
+   totals[slot.event()] = total;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::uint64_t events = argc > 1 ? std::stoull(argv[1]) : 4000;
+   const std::size_t hits = argc > 2 ? std::stoul(argv[2]) : std::size_t{1} << 18;
+   const std::size_t max_slots = argc > 3 ? std::stoul(argv[3]) : 64;
+   const std::size_t budget = (argc > 4 ? std::stoul(argv[4]) : 64) << 20;
+
+   whiteboard_schema schema;
+   Products products{schema.declare<std::pmr::vector<float>>("raw"), {}};
+   for(std::size_t i = 0; i < algorithms; ++i) {
+      products.reco.push_back(schema.declare<double>("reco" + std::to_string(i)));
+   }
+
+   thread_pool pool;
+   std::vector<double> expected, totals(events);
+   auto run = [&](event_loop::Config config) {
+      config.arena_size = hits * sizeof(float) + 4096;
+      event_loop loop{pool, schema, config};
+      std::fill(totals.begin(), totals.end(), 0.);
+      return loop.run(events, [&](event_slot& slot) -> task<> {
+         // The tasks start once this returns, in this order: the others wait
+         // for the raw data.
+         for(std::size_t i = 0; i < algorithms; ++i) {
+            slot.spawn(reconstruct(pool, slot, products, i));
+         }
+         slot.spawn(summarize(slot, products, totals));
+         slot.spawn(unpack(slot, products, hits));
+         co_return;
+      });
+   };
+   auto mb = [](std::size_t bytes) { return double(bytes) / double(1 << 20); };
+
+   std::cout << events << " events of " << hits << " hits, " << algorithms << " algorithms, " << pool.size()
+             << " threads\n";
+   std::cout << std::fixed << std::setprecision(1);
+
+   // First, in a fresh process: the allocator keeps some of the memory freed.
+   event_loop::Config adaptive;
+   adaptive.slots = 1;
+   adaptive.max_slots = 4 * max_slots;
+   adaptive.memory_budget = budget;
+   const auto tuned = run(adaptive);
+   expected = totals;
+   std::cout << "adaptive, budget " << mb(budget) << " MB: " << double(events) / tuned.seconds
+             << " events/s, peak RSS " << mb(tuned.peak_resident_bytes) << " MB, " << tuned.slots
+             << " slots at the end\n";
+   std::cout << std::setw(10) << "seconds" << std::setw(8) << "slots" << std::setw(12) << "events/s" << std::setw(10)
+             << "RSS MB" << '\n';
+   for(const auto& w : tuned.windows) {
+      std::cout << std::setw(10) << w.seconds << std::setw(8) << w.slots << std::setw(12) << w.events_per_second
+                << std::setw(10) << mb(w.resident_bytes) << '\n';
+   }
+
+   std::cout << "\nfixed number of slots\n";
+   std::cout << std::setw(8) << "slots" << std::setw(12) << "events/s" << std::setw(14) << "peak RSS MB" << '\n';
+   bool same = true;
+   for(std::size_t n = 1; n <= max_slots; n *= 2) {
+      event_loop::Config fixed;
+      fixed.slots = n;
+      fixed.max_slots = n;
+      fixed.adaptive = false;
+      const auto stats = run(fixed);
+      same &= totals == expected;
+      std::cout << std::setw(8) << n << std::setw(12) << double(events) / stats.seconds << std::setw(14)
+                << mb(stats.peak_resident_bytes) << '\n';
+   }
+
+   if(!same) {
+      std::cerr << "event results depend on the number of slots\n";
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
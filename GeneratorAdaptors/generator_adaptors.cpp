@@ -0,0 +1,215 @@
+#include <version>
+
+
+#ifdef __cpp_lib_generator
+#include "generator_adaptors.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <generator>
+#include <iomanip>
+#include <iostream>
+#include <ranges>
+#include <span>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+template <typename T>
+std::generator<T> sequence(T n) {
+   T x{};
+   while(x < n) {
+      co_yield x++;
+   }
+}
+
+
+static_assert(std::ranges::view<zip_view<std::generator<int>, std::generator<int>>>);
+static_assert(std::ranges::input_range<zip_view<std::generator<int>, std::generator<int>>>);
+static_assert(std::ranges::view<enumerate_view<std::generator<int>>>);
+static_assert(std::ranges::input_range<enumerate_view<std::generator<int>>>);
+
+
+// The adaptors written as plain coroutines, each adding a resume per element.
+template <std::ranges::input_range R>
+std::generator<std::tuple<std::size_t, std::ranges::range_reference_t<R>>> coroutine_enumerate(R source) {
+   std::size_t i = 0;
+   for(auto&& x : source) {
+      co_yield {i++, std::forward<decltype(x)>(x)};
+   }
+}
+
+
+template <std::ranges::input_range A, std::ranges::input_range B>
+std::generator<std::tuple<std::ranges::range_reference_t<A>, std::ranges::range_reference_t<B>>> coroutine_zip(
+    A a, B b) {
+   auto i = std::ranges::begin(a);
+   auto j = std::ranges::begin(b);
+   for(; i != std::ranges::end(a) && j != std::ranges::end(b); ++i, ++j) {
+      co_yield {*i, *j};
+   }
+}
+
+
+template <std::ranges::input_range R>
+std::generator<std::ranges::range_reference_t<std::ranges::range_reference_t<R>>> coroutine_join(R outer) {
+   for(auto&& inner : outer) {
+      for(auto&& x : inner) {
+         co_yield std::forward<decltype(x)>(x);
+      }
+   }
+}
+
+
+// n / m generators of m values each.
+std::generator<std::generator<std::uint64_t>> sequences(std::uint64_t n, std::uint64_t m) {
+   for(std::uint64_t i = 0; i < n / m; ++i) {
+      co_yield sequence(m);
+   }
+}
+
+
+// Millions of elements per second of f(), which returns a checksum.
+template <typename F>
+double rate(std::uint64_t n, F f, std::uint64_t& checksum) {
+   auto t0 = std::chrono::steady_clock::now();
+   checksum = f();
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   return double(n) / dt.count() / 1e6;
+}
+
+
+// Rates of the adaptor, the std::views composition and the plain coroutine,
+// zero where there is none, and their checksums.
+struct Row {
+   std::string name;
+   double rates[3] = {};
+   std::uint64_t sums[3] = {};
+};
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   using T = std::uint64_t;
+   const T n = argc > 1 ? std::stoull(argv[1]) : 1 << 24;
+   const std::size_t chunk_size = 256;
+   const T inner_size = 16;
+
+   std::vector<Row> rows;
+   {
+      auto& r = rows.emplace_back("enumerate");
+      auto sum = [](auto&& range) {
+         T s = 0;
+         for(auto&& [i, x] : range) {
+            s += i ^ x;
+         }
+         return s;
+      };
+      r.rates[0] = rate(n, [&] { return sum(enumerate(sequence(n))); }, r.sums[0]);
+#ifdef __cpp_lib_ranges_enumerate
+      r.rates[1] = rate(n, [&] { return sum(sequence(n) | std::views::enumerate); }, r.sums[1]);
+#endif
+      r.rates[2] = rate(n, [&] { return sum(coroutine_enumerate(sequence(n))); }, r.sums[2]);
+   }
+   {
+      auto& r = rows.emplace_back("zip");
+      auto sum = [](auto&& range) {
+         T s = 0;
+         for(auto&& [a, b] : range) {
+            s += a * b;
+         }
+         return s;
+      };
+      r.rates[0] = rate(n, [&] { return sum(zip(sequence(n), sequence(n))); }, r.sums[0]);
+#ifdef __cpp_lib_ranges_zip
+      r.rates[1] = rate(n, [&] { return sum(std::views::zip(sequence(n), sequence(n))); }, r.sums[1]);
+#endif
+      r.rates[2] = rate(n, [&] { return sum(coroutine_zip(sequence(n), sequence(n))); }, r.sums[2]);
+   }
+   {
+      auto& r = rows.emplace_back("chunk");
+      r.rates[0] = rate(
+          n,
+          [&] {
+             T s = 0;
+             for(auto c : chunk(sequence(n), chunk_size)) {
+                for(auto x : c) {
+                   s += x;
+                }
+                s ^= c.size();
+             }
+             return s;
+          },
+          r.sums[0]);
+#ifdef __cpp_lib_ranges_chunk
+      r.rates[1] = rate(
+          n,
+          [&] {
+             T s = 0;
+             for(auto c : sequence(n) | std::views::chunk(chunk_size)) {
+                T size = 0;
+                for(auto x : c) {
+                   s += x;
+                   ++size;
+                }
+                s ^= size;
+             }
+             return s;
+          },
+          r.sums[1]);
+#endif
+   }
+   {
+      auto& r = rows.emplace_back("join");
+      auto sum = [](auto&& range) {
+         T s = 0;
+         for(auto x : range) {
+            s += x;
+         }
+         return s;
+      };
+      r.rates[0] = rate(n, [&] { return sum(join(sequences(n, inner_size))); }, r.sums[0]);
+      r.rates[1] = rate(n, [&] { return sum(sequences(n, inner_size) | std::views::join); }, r.sums[1]);
+      r.rates[2] = rate(n, [&] { return sum(coroutine_join(sequences(n, inner_size))); }, r.sums[2]);
+   }
+
+   std::cout << n << " elements of sequence(n), chunks of " << chunk_size << ", join of generators of "
+             << inner_size << ", M elements/s\n";
+   std::cout << std::setw(12) << "" << std::setw(12) << "adaptor" << std::setw(12) << "std::views" << std::setw(12)
+             << "coroutine" << '\n';
+   std::cout << std::fixed << std::setprecision(0);
+   for(const auto& r : rows) {
+      std::cout << std::setw(12) << r.name;
+      for(auto rate : r.rates) {
+         if(rate > 0) {
+            std::cout << std::setw(12) << rate;
+         } else {
+            std::cout << std::setw(12) << "-";
+         }
+      }
+      std::cout << '\n';
+   }
+
+   for(const auto& r : rows) {
+      for(std::size_t i = 1; i < 3; ++i) {
+         if(r.rates[i] > 0 && r.sums[i] != r.sums[0]) {
+            std::cerr << r.name << ": results differ\n";
+            return EXIT_FAILURE;
+         }
+      }
+   }
+   return EXIT_SUCCESS;
+}
+
+
+#else
+
+
+#error std::generator IS NOT SUPPORTED
+
+
+#endif
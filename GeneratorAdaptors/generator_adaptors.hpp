@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <generator>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+// Adaptors for std::generator, made to add as few resumes as possible between
+// the consumer and the sources. An adaptor written as a coroutine adds one per
+// element, so zip and enumerate are views holding the iterators of their
+// sources, which add none. chunk resumes once per chunk, and join hands the
+// inner generators to the consumer with elements_of, which then resumes them
+// directly.
+
+
+// Tuples of the values of the sources, until one of them ends.
+template <std::ranges::input_range... Rs>
+class zip_view : public std::ranges::view_interface<zip_view<Rs...>> {
+public:
+   class iterator;
+
+   class sentinel {
+   public:
+      sentinel() = default;
+
+   private:
+      friend zip_view;
+      friend iterator;
+
+      explicit sentinel(std::tuple<std::ranges::sentinel_t<Rs>...> ends) : ends_{std::move(ends)} {
+      }
+
+      std::tuple<std::ranges::sentinel_t<Rs>...> ends_;
+   };
+
+   class iterator {
+   public:
+      using value_type = std::tuple<std::ranges::range_value_t<Rs>...>;
+      using difference_type = std::ptrdiff_t;
+
+      std::tuple<std::ranges::range_reference_t<Rs>...> operator*() const {
+         return std::apply([](auto&... it) { return std::tuple<std::ranges::range_reference_t<Rs>...>{*it...}; },
+                           current_);
+      }
+
+      iterator& operator++() {
+         std::apply([](auto&... it) { (++it, ...); }, current_);
+         return *this;
+      }
+
+      void operator++(int) {
+         ++*this;
+      }
+
+      friend bool operator==(const iterator& i, const sentinel& s) {
+         return i.done(s, std::index_sequence_for<Rs...>{});
+      }
+
+   private:
+      friend zip_view;
+
+      // The iterators of std::generator cannot be default-constructed.
+      explicit iterator(std::tuple<std::ranges::iterator_t<Rs>...> current) : current_{std::move(current)} {
+      }
+
+      template <std::size_t... I>
+      bool done(const sentinel& s, std::index_sequence<I...>) const {
+         return ((std::get<I>(current_) == std::get<I>(s.ends_)) || ...);
+      }
+
+      std::tuple<std::ranges::iterator_t<Rs>...> current_;
+   };
+
+   zip_view() = default;
+
+   explicit zip_view(Rs... sources) : sources_{std::move(sources)...} {
+   }
+
+   iterator begin() {
+      return iterator{std::apply([](auto&... s) { return std::tuple{std::ranges::begin(s)...}; }, sources_)};
+   }
+
+   sentinel end() {
+      return sentinel{std::apply([](auto&... s) { return std::tuple{std::ranges::end(s)...}; }, sources_)};
+   }
+
+private:
+   std::tuple<Rs...> sources_;
+};
+
+
+template <std::ranges::input_range... Rs>
+zip_view<std::views::all_t<Rs>...> zip(Rs&&... sources) {
+   return zip_view<std::views::all_t<Rs>...>{std::views::all(std::forward<Rs>(sources))...};
+}
+
+
+// Tuples (index, value) of the values of the source.
+template <std::ranges::input_range R>
+class enumerate_view : public std::ranges::view_interface<enumerate_view<R>> {
+public:
+   using sentinel = std::ranges::sentinel_t<R>;
+
+   class iterator {
+   public:
+      using value_type = std::tuple<std::size_t, std::ranges::range_value_t<R>>;
+      using difference_type = std::ptrdiff_t;
+
+      std::tuple<std::size_t, std::ranges::range_reference_t<R>> operator*() const {
+         return {index_, *current_};
+      }
+
+      iterator& operator++() {
+         ++current_;
+         ++index_;
+         return *this;
+      }
+
+      void operator++(int) {
+         ++*this;
+      }
+
+      friend bool operator==(const iterator& i, const sentinel& s) {
+         return i.current_ == s;
+      }
+
+   private:
+      friend enumerate_view;
+
+      explicit iterator(std::ranges::iterator_t<R> current) : current_{std::move(current)} {
+      }
+
+      std::ranges::iterator_t<R> current_;
+      std::size_t index_ = 0;
+   };
+
+   enumerate_view() = default;
+
+   explicit enumerate_view(R source) : source_{std::move(source)} {
+   }
+
+   iterator begin() {
+      return iterator{std::ranges::begin(source_)};
+   }
+
+   sentinel end() {
+      return std::ranges::end(source_);
+   }
+
+private:
+   R source_;
+};
+
+
+template <std::ranges::input_range R>
+enumerate_view<std::views::all_t<R>> enumerate(R&& source) {
+   return enumerate_view<std::views::all_t<R>>{std::views::all(std::forward<R>(source))};
+}
+
+
+// Spans of n consecutive values, the last one shorter if the values do not
+// divide. The values are moved into a buffer, which the spans show and which
+// the consumer may move from in turn.
+template <std::ranges::input_range R>
+std::generator<std::span<std::ranges::range_value_t<R>>> chunk(R source, std::size_t n) {
+   std::vector<std::ranges::range_value_t<R>> buffer;
+   buffer.reserve(n);
+   for(auto&& x : source) {
+      buffer.push_back(std::forward<decltype(x)>(x));
+      if(buffer.size() == n) {
+         co_yield std::span{buffer};
+         buffer.clear();
+      }
+   }
+   if(!buffer.empty()) {
+      co_yield std::span{buffer};
+   }
+}
+
+
+template <typename R>
+using inner_range_t = std::ranges::range_reference_t<R>;
+
+
+// The values of the inner ranges one after the other. Inner generators of the
+// same yielded type run nested: the consumer resumes them directly, and they
+// return to join only when they end.
+template <std::ranges::input_range R>
+   requires std::ranges::input_range<inner_range_t<R>>
+std::generator<std::ranges::range_reference_t<inner_range_t<R>>, std::ranges::range_value_t<inner_range_t<R>>> join(
+    R outer) {
+   for(auto&& inner : outer) {
+      co_yield std::ranges::elements_of(std::forward<decltype(inner)>(inner));
+   }
+}
@@ -0,0 +1,112 @@
+#include "histogram_sink.hpp"
+#include "sync_wait.hpp"
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Every thread fills its share of the values, starting at a different offset.
+template <typename Histogram>
+double fill(Histogram& h, const std::vector<double>& values, unsigned threads, std::uint64_t fills) {
+   auto t0 = std::chrono::steady_clock::now();
+   {
+      std::vector<std::jthread> workers;
+      for(unsigned t = 0; t < threads; ++t) {
+         workers.emplace_back([&, t] {
+            auto i = std::size_t(t) * 7919 % values.size();
+            for(std::uint64_t f = 0; f < fills; ++f) {
+               h.fill(values[i]);
+               i = i + 1 == values.size() ? 0 : i + 1;
+            }
+         });
+      }
+   }
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   return double(threads) * double(fills) / dt.count() / 1e6;
+}
+
+
+double entries(const histogram& h) {
+   double n = 0;
+   for(auto c : h.counts()) {
+      n += c;
+   }
+   return n;
+}
+
+
+template <typename F>
+double time_us(F&& f) {
+   auto t0 = std::chrono::steady_clock::now();
+   f();
+   return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::uint64_t total = argc > 1 ? std::stoull(argv[1]) : 1 << 24;
+   const unsigned max_threads = argc > 2 ? unsigned(std::stoul(argv[2])) : 64;
+
+   // The last value below high lands in the last bin, not in the overflow,
+   // also where rounding gives bins.
+   for(const histogram_axis edge : {histogram_axis{78, -10., -5.131}, histogram_axis{64, -10., -3.997}}) {
+      if(edge.index(std::nextafter(edge.high, edge.low)) != edge.bins || edge.index(edge.high) != edge.bins + 1 ||
+         edge.index(edge.low) != 1 || edge.index(std::nextafter(edge.low, -20.)) != 0) {
+         std::cerr << "values at the edges of the axis go to the wrong bins\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::vector<double> values(1 << 16);
+   std::mt19937_64 engine{1};
+   std::normal_distribution<double> gauss{0., 1.};
+   for(auto& v : values) {
+      v = gauss(engine);
+   }
+   thread_pool pool;
+
+   std::cout << total << " fills of a gaussian per row, " << pool.size() << " merge threads\n";
+   std::cout << std::setw(8) << "threads" << std::setw(8) << "bins" << std::setw(14) << "Mfills/s" << std::setw(14)
+             << "Mfills/s" << std::setw(14) << "merge us" << std::setw(14) << "merge us" << '\n';
+   std::cout << std::setw(8) << "" << std::setw(8) << "" << std::setw(14) << "per thread" << std::setw(14)
+             << "atomic bins" << std::setw(14) << "serial" << std::setw(14) << "on the pool" << '\n';
+
+   for(std::size_t bins : {64, 65536}) {
+      const histogram_axis axis{bins, -4., 4.};
+      for(unsigned threads = 1; threads <= max_threads; threads *= 2) {
+         const std::uint64_t fills = total / threads;
+
+         histogram_sink sink{axis};
+         auto sink_rate = fill(sink, values, threads, fills);
+         atomic_histogram shared{axis};
+         auto atomic_rate = fill(shared, values, threads, fills);
+
+         histogram merged{axis};
+         auto serial = time_us([&] { merged = sink.merge(); });
+         auto tree = time_us([&] { merged = sync_wait(sink.merge(pool)); });
+
+         std::cout << std::setw(8) << threads << std::setw(8) << bins << std::fixed << std::setprecision(1)
+                   << std::setw(14) << sink_rate << std::setw(14) << atomic_rate << std::setw(14) << serial
+                   << std::setw(14) << tree << '\n';
+
+         if(sink.threads() != threads || entries(merged) != double(threads * fills) ||
+            merged.counts() != shared.snapshot().counts()) {
+            std::cerr << "merged " << entries(merged) << " of " << threads * fills << " entries\n";
+            return EXIT_FAILURE;
+         }
+      }
+   }
+
+   return EXIT_SUCCESS;
+}
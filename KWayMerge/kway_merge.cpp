@@ -0,0 +1,156 @@
+#include <version>
+
+
+#ifdef __cpp_lib_generator
+#include "kway_merge.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <generator>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+// Record of one input file, ordered by time. Times repeat, within and between
+// inputs.
+struct Record {
+   std::uint64_t time;
+   std::uint32_t source;
+   std::uint32_t payload;
+
+   bool operator==(const Record&) const = default;
+};
+
+
+std::generator<Record> input(std::uint32_t source, std::size_t n) {
+   std::minstd_rand engine{source + 1};
+   std::uniform_int_distribution<std::uint64_t> step{0, 8};
+   std::uint64_t time = 0;
+   for(std::size_t i = 0; i < n; ++i) {
+      time += step(engine);
+      co_yield Record{time, source, std::uint32_t(engine())};
+   }
+}
+
+
+std::generator<std::string> words(std::vector<std::string> sorted) {
+   for(const auto& w : sorted) {
+      co_yield w;
+   }
+}
+
+
+std::vector<std::generator<Record>> inputs(std::size_t k, std::size_t n) {
+   std::vector<std::generator<Record>> result;
+   for(std::size_t s = 0; s < k; ++s) {
+      result.push_back(input(std::uint32_t(s), n / k + (s < n % k)));
+   }
+   return result;
+}
+
+
+std::vector<Record> merged(std::size_t k, std::size_t n) {
+   std::vector<Record> out;
+   out.reserve(n);
+   for(auto&& r : merge(inputs(k, n), std::ranges::less{}, &Record::time)) {
+      out.push_back(r);
+   }
+   return out;
+}
+
+
+// The same order: sorting by time and, for equal times, by input keeps the
+// records of one input in their order, as their times grow.
+std::vector<Record> sorted(std::size_t k, std::size_t n) {
+   std::vector<Record> out;
+   out.reserve(n);
+   for(auto& g : inputs(k, n)) {
+      for(auto&& r : g) {
+         out.push_back(r);
+      }
+   }
+   std::ranges::stable_sort(out, [](const Record& a, const Record& b) {
+      return a.time < b.time || (a.time == b.time && a.source < b.source);
+   });
+   return out;
+}
+
+
+// Millions of records per second.
+template <typename F>
+double rate(std::size_t n, F f, std::vector<Record>& out) {
+   auto t0 = std::chrono::steady_clock::now();
+   out = f();
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   return double(n) / dt.count() / 1e6;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::size_t n = argc > 1 ? std::stoul(argv[1]) : 1 << 22;
+
+   // Tiny cases, against std::ranges::merge.
+   {
+      std::vector<std::vector<int>> v{{1, 3, 5, 7}, {}, {2, 3, 4}, {0, 9}, {3}};
+      std::vector<int> expected, out;
+      for(const auto& s : v) {
+         std::vector<int> m;
+         std::ranges::merge(expected, s, std::back_inserter(m));
+         expected = std::move(m);
+      }
+      for(int x : merge(v)) {
+         out.push_back(x);
+      }
+      auto none = merge(std::vector<std::vector<int>>{});
+      if(out != expected || none.begin() != none.end()) {
+         std::cerr << "merge of vectors is wrong\n";
+         return EXIT_FAILURE;
+      }
+   }
+   {
+      // Generators yield rvalue references, which the keys must not move from.
+      std::vector<std::generator<std::string>> sources;
+      sources.push_back(words({"apple", "kiwi"}));
+      sources.push_back(words({"banana", "cherry", "plum"}));
+      std::vector<std::string> out;
+      for(auto&& w : merge(std::move(sources))) {
+         out.push_back(w);
+      }
+      if(out != std::vector<std::string>{"apple", "banana", "cherry", "kiwi", "plum"}) {
+         std::cerr << "merge of string generators is wrong\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::cout << n << " records, M records/s\n";
+   std::cout << std::setw(8) << "inputs" << std::setw(16) << "loser tree" << std::setw(16) << "concat + sort"
+             << '\n';
+   std::cout << std::fixed << std::setprecision(1);
+   for(std::size_t k = 2; k <= 1024; k *= 2) {
+      std::vector<Record> a, b;
+      const auto merge_rate = rate(n, [&] { return merged(k, n); }, a);
+      const auto sort_rate = rate(n, [&] { return sorted(k, n); }, b);
+      std::cout << std::setw(8) << k << std::setw(16) << merge_rate << std::setw(16) << sort_rate << '\n';
+      if(a != b) {
+         std::cerr << k << " inputs: merged and sorted records differ\n";
+         return EXIT_FAILURE;
+      }
+   }
+   return EXIT_SUCCESS;
+}
+
+
+#else
+
+
+#error std::generator IS NOT SUPPORTED
+
+
+#endif
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <generator>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Tournament over the current values of k sorted sources, of which the winner
+// is the smallest. Internal node n of the complete binary tree holds the loser
+// of the match played there, leaves k..2k-1 are the sources. Replacing the
+// winner replays only the matches on its path to the root, log2(k) comparisons
+// against the stored losers. Exhausted sources lose every match, and ties go to
+// the lower source index, which makes the merge stable. The projected keys of
+// the current values are kept next to the tree, for the matches not to chase
+// pointers into the sources.
+template <std::ranges::input_range R, typename Compare, typename Proj>
+class loser_tree {
+public:
+   loser_tree(std::vector<R>& sources, Compare& comp, Proj& proj)
+      : comp_{comp}, proj_{proj}, tree_(sources.size()) {
+      current_.reserve(sources.size());
+      ends_.reserve(sources.size());
+      keys_.reserve(sources.size());
+      for(auto& s : sources) {
+         current_.push_back(std::ranges::begin(s));
+         ends_.push_back(std::ranges::end(s));
+         keys_.emplace_back();
+         load(keys_.size() - 1);
+      }
+      if(!sources.empty()) {
+         tree_[0] = play(1);
+      }
+   }
+
+   bool empty() const {
+      return current_.empty() || keys_[tree_[0]].done;
+   }
+
+   std::ranges::range_reference_t<R> top() const {
+      return *current_[tree_[0]];
+   }
+
+   // Advances the winning source and finds the next winner.
+   void pop() {
+      auto winner = tree_[0];
+      ++current_[winner];
+      load(winner);
+      for(auto n = (winner + current_.size()) / 2; n > 0; n /= 2) {
+         const auto loser = tree_[n];
+         const bool swap = beats(loser, winner);
+         tree_[n] = swap ? winner : loser;
+         winner = swap ? loser : winner;
+      }
+      tree_[0] = winner;
+   }
+
+private:
+   using value_lvalue = const std::remove_reference_t<std::ranges::range_reference_t<R>>&;
+   using key_type = std::remove_cvref_t<std::invoke_result_t<Proj&, value_lvalue>>;
+
+   struct Key {
+      key_type value{};
+      bool done = true;
+   };
+
+   void load(std::size_t i) {
+      keys_[i].done = current_[i] == ends_[i];
+      if(!keys_[i].done) {
+         // Projected from a const lvalue: the rvalue references of e.g. a
+         // std::generator<T> would move the value into the key, and top()
+         // would then yield what is left of it.
+         auto&& value = *current_[i];
+         keys_[i].value = std::invoke(proj_, std::as_const(value));
+      }
+   }
+
+   // Without branches, which mispredict half of the time in a merge. The key
+   // of an exhausted source is stale but still compares; which of two
+   // exhausted sources wins does not matter.
+   bool beats(std::size_t a, std::size_t b) const {
+      const Key &ka = keys_[a], &kb = keys_[b];
+      const bool less = std::invoke(comp_, ka.value, kb.value);
+      const bool tie = !less & !std::invoke(comp_, kb.value, ka.value);
+      return ka.done != kb.done ? kb.done : less | (tie & (a < b));
+   }
+
+   // Plays the matches below node n, returning its winner.
+   std::size_t play(std::size_t n) {
+      if(n >= current_.size()) {
+         return n - current_.size();
+      }
+      auto a = play(2 * n), b = play(2 * n + 1);
+      if(beats(b, a)) {
+         std::swap(a, b);
+      }
+      tree_[n] = b;
+      return a;
+   }
+
+   Compare& comp_;
+   Proj& proj_;
+   std::vector<std::ranges::iterator_t<R>> current_;
+   std::vector<std::ranges::sentinel_t<R>> ends_;
+   std::vector<Key> keys_;
+   std::vector<std::size_t> tree_;  // winner first, then the losers
+};
+
+
+// Lazily merges sources sorted by comp of their projections, e.g. the
+// generators reading many time-ordered files. The merged range yields the
+// references of the sources, so values are not copied on the way.
+template <std::ranges::input_range R, typename Compare = std::ranges::less, typename Proj = std::identity>
+   requires std::indirect_strict_weak_order<Compare, std::projected<std::ranges::iterator_t<R>, Proj>>
+std::generator<std::ranges::range_reference_t<R>> merge(std::vector<R> sources, Compare comp = {},
+                                                          Proj proj = {}) {
+   loser_tree<R, Compare, Proj> tree{sources, comp, proj};
+   for(; !tree.empty(); tree.pop()) {
+      co_yield tree.top();
+   }
+}
+
+
+template <std::ranges::input_range R, std::same_as<R>... Rs>
+std::generator<std::ranges::range_reference_t<R>> merge(R first, Rs... rest) {
+   std::vector<R> sources;
+   sources.reserve(1 + sizeof...(rest));
+   sources.push_back(std::move(first));
+   (sources.push_back(std::move(rest)), ...);
+   return merge(std::move(sources));
+}
@@ -0,0 +1,139 @@
+#include <version>
+
+
+#ifdef __cpp_lib_generator
+#include "ntuple.hpp"
+#include "sync_wait.hpp"
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <generator>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+
+struct Event {
+   std::uint64_t number;
+   std::int32_t run;
+   std::uint16_t hits;
+   float energy;
+   double px;
+};
+
+
+std::generator<const Event&> events(std::uint64_t n) {
+   std::mt19937_64 engine{1};
+   std::poisson_distribution<int> hits{20.};
+   std::exponential_distribution<float> energy{0.1f};
+   std::normal_distribution<double> px{0., 5.};
+   Event e{};
+   for(std::uint64_t i = 0; i < n; ++i) {
+      e = {i, std::int32_t(1000 + i / 100000), std::uint16_t(hits(engine)), energy(engine), px(engine)};
+      co_yield e;
+   }
+}
+
+
+// Order dependent, so that lost or reordered events are noticed.
+struct Checksum {
+   std::uint64_t value = 0;
+
+   void add(const Event& e) noexcept {
+      value = value * 31 + e.number + std::uint64_t(e.run) * 7 + e.hits * 13 + std::uint64_t(e.energy * 1e3f) +
+              std::uint64_t(std::llround(e.px * 1e6));
+   }
+};
+
+
+constexpr double record_bytes = sizeof(std::uint64_t) + sizeof(std::int32_t) + sizeof(std::uint16_t) +
+                                sizeof(float) + sizeof(double);
+
+
+double mb_per_s(double bytes, std::chrono::steady_clock::time_point t0) {
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   return bytes / dt.count() / 1e6;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::uint64_t n = argc > 1 ? std::stoull(argv[1]) : 1 << 22;
+   // Directory of the file written and read back. The default may be a tmpfs, in memory.
+   const std::filesystem::path dir = argc > 2 ? argv[2] : std::filesystem::temp_directory_path().string();
+   const auto path = dir / ("ntuple_" + std::to_string(::getpid()) + ".bin");
+   thread_pool pool;
+
+   auto t0 = std::chrono::steady_clock::now();
+   Checksum expected;
+   for(const auto& e : events(n)) {
+      expected.add(e);
+   }
+
+   std::cout << n << " events of 5 columns, " << record_bytes * double(n) / 1e6 << " MB of column data, generated at "
+             << std::fixed << std::setprecision(0) << mb_per_s(record_bytes * double(n), t0) << " MB/s\n";
+   std::cout << std::setw(14) << "pages" << std::setw(10) << "ratio" << std::setw(12) << "write MB/s"
+             << std::setw(12) << "read MB/s" << std::setw(12) << "read MB/s" << '\n';
+   std::cout << std::setw(14) << "" << std::setw(10) << "" << std::setw(12) << "" << std::setw(12) << "records"
+             << std::setw(12) << "1 column" << '\n';
+
+   for(bool compress : {false, true}) {
+      using Writer = NtupleWriter<&Event::number, &Event::run, &Event::hits, &Event::energy, &Event::px>;
+      using Reader = NtupleReader<&Event::number, &Event::run, &Event::hits, &Event::energy, &Event::px>;
+
+      t0 = std::chrono::steady_clock::now();
+      Writer::Stats stats;
+      {
+         Writer writer{pool, path, {.compress = compress}};
+         sync_wait(writer.write(events(n)));
+         sync_wait(writer.close());
+         stats = writer.stats();
+      }
+      auto write_rate = mb_per_s(record_bytes * double(n), t0);
+
+      Reader reader{path};
+      t0 = std::chrono::steady_clock::now();
+      Checksum read;
+      for(const auto& e : reader.records()) {
+         read.add(e);
+      }
+      auto read_rate = mb_per_s(record_bytes * double(n), t0);
+
+      t0 = std::chrono::steady_clock::now();
+      std::uint64_t hits = 0, entries = 0;
+      for(auto h : reader.column<2>()) {
+         hits += h;
+         ++entries;
+      }
+      auto column_rate = mb_per_s(sizeof(std::uint16_t) * double(n), t0);
+
+      std::cout << std::setw(14) << (compress ? "delta packed" : "plain") << std::fixed << std::setprecision(2)
+                << std::setw(10) << double(stats.column_bytes) / double(stats.page_bytes) << std::setprecision(0)
+                << std::setw(12) << write_rate << std::setw(12) << read_rate << std::setw(12) << column_rate
+                << '\n';
+
+      if(stats.entries != n || reader.entries() != n || read.value != expected.value || entries != n ||
+         hits == 0) {
+         std::cerr << "read back " << reader.entries() << " of " << n << " events\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::filesystem::remove(path);
+   return EXIT_SUCCESS;
+}
+
+
+#else
+
+
+#error std::generator IS NOT SUPPORTED
+
+
+#endif
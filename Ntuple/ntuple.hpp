@@ -0,0 +1,430 @@
+#pragma once
+
+#include "async_writer.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <generator>
+#include <ranges>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+// Columnar storage of records, in the spirit of an ntuple. The columns are
+// data members of a record type, named by member pointers:
+//
+//    NtupleWriter<&Event::number, &Event::energy> writer{pool, path, {}};
+//
+// The file is written with an async_writer of a single lane, so it consists of
+// blocks of uint32_t length-prefixed records. The first one is a FileHeader
+// describing the columns. Every other one is a cluster of page_entries
+// records: a ClusterHeader followed by one page per column, a PageHeader and
+// its payload. Integer pages are stored as zigzag-encoded deltas packed to the
+// bit width of the largest one, when that is smaller than the plain values.
+namespace detail {
+
+
+template <auto Member>
+struct ntuple_member;
+
+template <typename Record, typename T, T Record::*Member>
+struct ntuple_member<Member> {
+   static_assert(std::is_arithmetic_v<T>, "ntuple columns are arithmetic data members");
+   using record = Record;
+   using type = T;
+};
+
+
+template <auto... Members>
+using ntuple_record = std::tuple_element_t<0, std::tuple<typename ntuple_member<Members>::record...>>;
+
+
+struct FileHeader {
+   char magic[4] = {'N', 'T', 'P', 'L'};
+   std::uint32_t version = 1;
+   std::uint32_t block_size;
+   std::uint32_t columns;
+};
+
+
+struct ClusterHeader {
+   std::uint64_t first_entry;
+   std::uint32_t entries;
+   std::uint32_t columns;
+};
+
+
+enum class PageEncoding : std::uint32_t { plain, delta_packed };
+
+
+struct PageHeader {
+   PageEncoding encoding;
+   std::uint32_t bytes;  // of the payload, a multiple of 8
+   std::uint32_t bit_width;
+   std::uint32_t reserved = 0;
+   std::uint64_t base;  // first value, for delta_packed
+};
+
+
+// Kind and size of a column, as stored in the file header.
+template <typename T>
+constexpr std::uint32_t column_type() noexcept {
+   constexpr std::uint32_t kind = std::is_floating_point_v<T> ? 2 : std::is_signed_v<T> ? 1 : 0;
+   return kind << 8 | sizeof(T);
+}
+
+
+template <typename T>
+T load(const std::byte* p) noexcept {
+   T value;
+   std::memcpy(&value, p, sizeof(value));
+   return value;
+}
+
+
+template <typename T>
+void store(std::vector<std::byte>& out, const T& value) {
+   auto size = out.size();
+   out.resize(size + sizeof(value));
+   std::memcpy(out.data() + size, &value, sizeof(value));
+}
+
+
+// Sign-extends, so that deltas between negative values stay small.
+template <typename T>
+std::uint64_t to_bits(T value) noexcept {
+   if constexpr(std::is_signed_v<T>) {
+      return std::uint64_t(std::int64_t(value));
+   } else {
+      return std::uint64_t(value);
+   }
+}
+
+
+// Appends the header and payload of a page holding the values.
+template <typename T>
+void encode_page(const std::vector<T>& values, bool compress, std::vector<std::byte>& out) {
+   const std::size_t plain_bytes = (values.size() * sizeof(T) + 7) / 8 * 8;
+   PageHeader header{PageEncoding::plain, std::uint32_t(plain_bytes), 0, 0, 0};
+
+   if constexpr(std::is_integral_v<T>) {
+      if(compress && !values.empty()) {
+         std::uint64_t widest = 0;
+         auto previous = to_bits(values[0]);
+         for(auto v : values) {
+            auto delta = std::int64_t(to_bits(v) - previous);
+            widest |= std::uint64_t(delta) << 1 ^ std::uint64_t(delta >> 63);
+            previous = to_bits(v);
+         }
+         const unsigned width = unsigned(std::bit_width(widest));
+         const std::size_t packed_bytes = (values.size() * width + 63) / 64 * 8;
+         if(packed_bytes < plain_bytes) {
+            header = {PageEncoding::delta_packed, std::uint32_t(packed_bytes), width, 0, to_bits(values[0])};
+            store(out, header);
+            auto begin = out.size();
+            out.resize(begin + packed_bytes);
+            std::vector<std::uint64_t> words(packed_bytes / 8);
+            previous = header.base;
+            std::size_t bit = 0;
+            for(auto v : values) {
+               auto delta = std::int64_t(to_bits(v) - previous);
+               auto zigzag = std::uint64_t(delta) << 1 ^ std::uint64_t(delta >> 63);
+               previous = to_bits(v);
+               if(width > 0) {
+                  words[bit / 64] |= zigzag << bit % 64;
+                  if(bit % 64 + width > 64) {
+                     words[bit / 64 + 1] |= zigzag >> (64 - bit % 64);
+                  }
+               }
+               bit += width;
+            }
+            if(packed_bytes > 0) {
+               std::memcpy(out.data() + begin, words.data(), packed_bytes);
+            }
+            return;
+         }
+      }
+   }
+
+   store(out, header);
+   auto begin = out.size();
+   out.resize(begin + plain_bytes);
+   std::memcpy(out.data() + begin, values.data(), values.size() * sizeof(T));
+}
+
+
+// Decodes the page at p into values, returns where the next page starts.
+template <typename T>
+const std::byte* decode_page(const std::byte* p, std::uint32_t entries, std::vector<T>& values) {
+   const auto header = load<PageHeader>(p);
+   p += sizeof(PageHeader);
+   values.resize(entries);
+
+   if(header.encoding == PageEncoding::plain) {
+      std::memcpy(values.data(), p, entries * sizeof(T));
+   } else if constexpr(std::is_integral_v<T>) {
+      const unsigned width = header.bit_width;
+      const std::uint64_t mask = width == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << width) - 1;
+      auto previous = header.base;
+      std::size_t bit = 0;
+      for(auto& v : values) {
+         std::uint64_t zigzag = 0;
+         if(width > 0) {
+            zigzag = load<std::uint64_t>(p + bit / 64 * 8) >> bit % 64;
+            if(bit % 64 + width > 64) {
+               zigzag |= load<std::uint64_t>(p + bit / 64 * 8 + 8) << (64 - bit % 64);
+            }
+            zigzag &= mask;
+         }
+         previous += zigzag >> 1 ^ (~(zigzag & 1) + 1);
+         v = T(previous);
+         bit += width;
+      }
+   } else {
+      throw std::runtime_error{"ntuple: packed page in a floating point column"};
+   }
+   return p + header.bytes;
+}
+
+
+}  // namespace detail
+
+
+template <auto... Members>
+class NtupleWriter {
+public:
+   using Record = detail::ntuple_record<Members...>;
+   static_assert((std::is_same_v<Record, typename detail::ntuple_member<Members>::record> && ...),
+                 "ntuple columns are members of one record type");
+
+   struct Config {
+      std::uint32_t page_entries = 8192;
+      bool compress = true;
+      std::size_t block_size = 4 << 20;
+      bool direct = true;
+   };
+
+   struct Stats {
+      std::uint64_t entries;
+      std::uint64_t clusters;
+      std::uint64_t column_bytes;  // of the plain values
+      std::uint64_t page_bytes;    // as stored
+   };
+
+   NtupleWriter(thread_pool& pool, const std::filesystem::path& path, Config config)
+      : config_{config}, out_{pool, path, {.buffer_size = config.block_size, .lanes = 1, .direct = config.direct}} {
+      const std::size_t cluster_size =
+         sizeof(std::uint32_t) + sizeof(detail::ClusterHeader) +
+         ((sizeof(detail::PageHeader) + (config.page_entries * sizeof(typename detail::ntuple_member<Members>::type) + 7) / 8 * 8) + ...);
+      if(config.page_entries == 0 || cluster_size > out_.buffer_size()) {
+         throw std::invalid_argument{"NtupleWriter: clusters do not fit into a block"};
+      }
+      std::apply([&](auto&... c) { (c.reserve(config.page_entries), ...); }, columns_);
+   }
+
+   NtupleWriter(const NtupleWriter&) = delete;
+   NtupleWriter& operator=(const NtupleWriter&) = delete;
+
+   // Appends the records of the range, e.g. a std::generator. Pages are
+   // written in the background while the range produces the next ones. One
+   // coroutine writes at a time.
+   template <std::ranges::input_range R>
+      requires std::convertible_to<std::ranges::range_reference_t<R>, const Record&>
+   task<> write(R records) {
+      co_await write_header();
+      for(const Record& r : records) {
+         std::apply([&](auto&... c) { (c.push_back(r.*Members), ...); }, columns_);
+         if(std::get<0>(columns_).size() == config_.page_entries) {
+            co_await write_cluster();
+         }
+      }
+   }
+
+   // Writes the last cluster and flushes the file. co_await it before
+   // destroying the writer.
+   task<> close() {
+      co_await write_header();
+      if(!std::get<0>(columns_).empty()) {
+         co_await write_cluster();
+      }
+      co_await out_.flush();
+   }
+
+   Stats stats() const noexcept {
+      return stats_;
+   }
+
+private:
+   task<> write_header() {
+      if(header_written_) {
+         co_return;
+      }
+      header_written_ = true;
+      buffer_.clear();
+      detail::store(buffer_, detail::FileHeader{.block_size = std::uint32_t(out_.buffer_size()),
+                                                .columns = std::uint32_t(sizeof...(Members))});
+      (detail::store(buffer_, detail::column_type<typename detail::ntuple_member<Members>::type>()), ...);
+      co_await out_.write(buffer_);
+   }
+
+   task<> write_cluster() {
+      const auto entries = std::uint32_t(std::get<0>(columns_).size());
+      buffer_.clear();
+      detail::store(buffer_, detail::ClusterHeader{stats_.entries, entries, std::uint32_t(sizeof...(Members))});
+      std::apply(
+         [&](auto&... c) {
+            ((stats_.column_bytes += c.size() * sizeof(c[0])), ...);
+            (detail::encode_page(c, config_.compress, buffer_), ...);
+            (c.clear(), ...);
+         },
+         columns_);
+      stats_.entries += entries;
+      ++stats_.clusters;
+      stats_.page_bytes += buffer_.size() - sizeof(detail::ClusterHeader) -
+                           sizeof...(Members) * sizeof(detail::PageHeader);
+      co_await out_.write(buffer_);
+   }
+
+   const Config config_;
+   async_writer out_;
+   std::tuple<std::vector<typename detail::ntuple_member<Members>::type>...> columns_;
+   // Encoded cluster, copied by the async_writer.
+   std::vector<std::byte> buffer_;
+   bool header_written_ = false;
+   Stats stats_{};
+};
+
+
+// Reads a file of an NtupleWriter with the same columns, mapped into memory.
+// records() and column<I>() are generators decoding one cluster at a time;
+// column<I>() only touches the pages of its column.
+template <auto... Members>
+class NtupleReader {
+public:
+   using Record = detail::ntuple_record<Members...>;
+
+   template <std::size_t I>
+   using column_type = std::tuple_element_t<I, std::tuple<typename detail::ntuple_member<Members>::type...>>;
+
+   explicit NtupleReader(const std::filesystem::path& path) {
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if(fd < 0) {
+         throw std::system_error{errno, std::generic_category(), path.string()};
+      }
+      struct stat st;
+      ::fstat(fd, &st);
+      size_ = std::size_t(st.st_size);
+      if(size_ > 0) {
+         void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+         data_ = p == MAP_FAILED ? nullptr : static_cast<const std::byte*>(p);
+      }
+      ::close(fd);
+      if(!data_) {
+         throw std::system_error{errno, std::generic_category(), "NtupleReader: mmap " + path.string()};
+      }
+      ::madvise(const_cast<std::byte*>(data_), size_, MADV_SEQUENTIAL);
+      try {
+         index();
+      } catch(...) {
+         ::munmap(const_cast<std::byte*>(data_), size_);
+         throw;
+      }
+   }
+
+   NtupleReader(const NtupleReader&) = delete;
+   NtupleReader& operator=(const NtupleReader&) = delete;
+
+   ~NtupleReader() {
+      ::munmap(const_cast<std::byte*>(data_), size_);
+   }
+
+   std::uint64_t entries() const noexcept {
+      return entries_;
+   }
+
+   std::size_t clusters() const noexcept {
+      return clusters_.size();
+   }
+
+   std::size_t file_size() const noexcept {
+      return size_;
+   }
+
+   std::generator<const Record&> records() {
+      std::tuple<std::vector<typename detail::ntuple_member<Members>::type>...> columns;
+      Record r{};
+      for(const auto* cluster : clusters_) {
+         const auto header = detail::load<detail::ClusterHeader>(cluster);
+         const auto* page = cluster + sizeof(detail::ClusterHeader);
+         std::apply([&](auto&... c) { ((page = detail::decode_page(page, header.entries, c)), ...); }, columns);
+         for(std::uint32_t i = 0; i < header.entries; ++i) {
+            std::apply([&](const auto&... c) { ((r.*Members = c[i]), ...); }, columns);
+            co_yield r;
+         }
+      }
+   }
+
+   template <std::size_t I>
+   std::generator<column_type<I>> column() {
+      std::vector<column_type<I>> values;
+      for(const auto* cluster : clusters_) {
+         const auto header = detail::load<detail::ClusterHeader>(cluster);
+         const auto* page = cluster + sizeof(detail::ClusterHeader);
+         for(std::size_t c = 0; c < I; ++c) {
+            page += sizeof(detail::PageHeader) + detail::load<detail::PageHeader>(page).bytes;
+         }
+         detail::decode_page(page, header.entries, values);
+         for(auto v : values) {
+            co_yield v;
+         }
+      }
+   }
+
+private:
+   // Finds the clusters and checks that the columns match.
+   void index() {
+      if(size_ < sizeof(std::uint32_t) + sizeof(detail::FileHeader)) {
+         throw std::runtime_error{"NtupleReader: no file header"};
+      }
+      const auto header = detail::load<detail::FileHeader>(data_ + sizeof(std::uint32_t));
+      const std::uint32_t types[] = {detail::column_type<typename detail::ntuple_member<Members>::type>()...};
+      if(std::memcmp(header.magic, "NTPL", 4) != 0 || header.version != 1 || header.block_size == 0 ||
+         size_ % header.block_size != 0 || header.columns != sizeof...(Members) ||
+         std::memcmp(data_ + sizeof(std::uint32_t) + sizeof(header), types, sizeof(types)) != 0) {
+         throw std::runtime_error{"NtupleReader: not a file of these columns"};
+      }
+
+      for(std::size_t block = 0; block < size_; block += header.block_size) {
+         for(std::size_t pos = 0; pos + sizeof(std::uint32_t) <= header.block_size;) {
+            const auto length = detail::load<std::uint32_t>(data_ + block + pos);
+            if(length == 0) {
+               break;
+            }
+            if(block + pos > 0) {
+               clusters_.push_back(data_ + block + pos + sizeof(length));
+               entries_ += detail::load<detail::ClusterHeader>(clusters_.back()).entries;
+            }
+            pos += sizeof(length) + length;
+         }
+      }
+   }
+
+   const std::byte* data_ = nullptr;
+   std::size_t size_ = 0;
+   std::vector<const std::byte*> clusters_;
+   std::uint64_t entries_ = 0;
+};
@@ -0,0 +1,138 @@
+#include <version>
+
+
+#ifdef __cpp_lib_generator
+#include "parallel_reduce.hpp"
+#include "sync_wait.hpp"
+#include "thread_pool.hpp"
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <generator>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Values of both signs spread over 40 binary orders of magnitude, which makes
+// the sum depend on the order of the additions.
+std::generator<double> values(std::uint64_t n) {
+   for(std::uint64_t i = 0; i < n; ++i) {
+      // splitmix64
+      std::uint64_t z = (i + 1) * 0x9E3779B97F4A7C15;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+      z ^= z >> 31;
+      const double mantissa = double(z >> 11) * 0x1p-53;
+      co_yield std::ldexp(z & 1 ? mantissa : -mantissa, int(z >> 1 & 31) - 20);
+   }
+}
+
+
+// Some work per value.
+constexpr auto transform = [](double x) { return x * std::exp(-1e-6 * x * x); };
+
+
+struct Run {
+   double sum;
+   double seconds;
+};
+
+
+template <accumulator A>
+Run run(unsigned threads, std::uint64_t n, std::size_t chunk_size = 4096) {
+   thread_pool pool{threads};
+   auto t0 = std::chrono::steady_clock::now();
+   const double sum = sync_wait(parallel_transform_reduce<A>(pool, values(n), transform, chunk_size));
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   return {sum, dt.count()};
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::uint64_t n = argc > 1 ? std::stoull(argv[1]) : 1 << 24;
+
+   // Exact sums of a few cases that defeat the others.
+   {
+      exact_sum s;
+      for(double x : {1e100, 1., -1e100, 1e-100, 1.}) {
+         s.add(x);
+      }
+      exact_sum t;
+      for(double x : {0.1, 0.2, 0.3, -0.6}) {
+         t.add(x);
+      }
+      kahan_sum k;
+      for(double x : {1., 1e100, 1., -1e100}) {
+         k.add(x);
+      }
+      if(s.value() != 2. || t.value() != 0x1p-55 || k.value() != 2.) {
+         std::cerr << "known sums are wrong\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   // Serial plain sum, in the order of the values.
+   double serial = 0;
+   for(double x : values(n)) {
+      serial += transform(x);
+   }
+   // The exact sum does not depend on the chunks.
+   const double exact = run<exact_sum>(1, n, 1000).sum;
+
+   std::vector<unsigned> threads;
+   for(unsigned t = 1; t <= std::max(8u, std::thread::hardware_concurrency()); t *= 2) {
+      threads.push_back(t);
+   }
+
+   std::cout << n << " values, seconds by threads\n";
+   std::cout << std::setw(16) << "" << std::setw(26) << "sum" << std::setw(12) << "error";
+   for(auto t : threads) {
+      std::cout << std::setw(8) << t;
+   }
+   std::cout << '\n';
+   auto print = [&](const char* name, double sum) {
+      std::cout << std::setw(16) << name << std::setprecision(17) << std::setw(26) << sum << std::setprecision(2)
+                << std::setw(12) << (sum - exact) / std::abs(exact);
+   };
+   print("serial", serial);
+   std::cout << '\n';
+
+   bool reproducible = true;
+   auto report = [&](const char* name, auto run) {
+      std::vector<Run> runs;
+      for(auto t : threads) {
+         runs.push_back(run(t));
+      }
+      print(name, runs[0].sum);
+      for(const auto& r : runs) {
+         std::cout << std::setw(8) << std::fixed << r.seconds << std::defaultfloat;
+         reproducible &= std::bit_cast<std::uint64_t>(r.sum) == std::bit_cast<std::uint64_t>(runs[0].sum);
+      }
+      std::cout << '\n';
+   };
+   report("plain_sum", [&](unsigned t) { return run<plain_sum>(t, n); });
+   report("kahan_sum", [&](unsigned t) { return run<kahan_sum>(t, n); });
+   report("exact_sum", [&](unsigned t) { return run<exact_sum>(t, n); });
+
+   if(!reproducible || run<exact_sum>(3, n).sum != exact) {
+      std::cerr << "sums are not reproducible\n";
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
+
+
+#else
+
+
+#error std::generator IS NOT SUPPORTED
+
+
+#endif
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <mutex>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+
+// Sums of doubles: add() a value, merge() another sum of the same kind, and
+// value() the result.
+template <typename A>
+concept accumulator = std::default_initializable<A> && std::movable<A> && requires(A a, const A& b, double x) {
+   a.add(x);
+   a.merge(b);
+   { a.value() } -> std::convertible_to<double>;
+};
+
+
+class plain_sum {
+public:
+   void add(double x) noexcept {
+      sum_ += x;
+   }
+
+   void merge(const plain_sum& s) noexcept {
+      sum_ += s.sum_;
+   }
+
+   double value() const noexcept {
+      return sum_;
+   }
+
+private:
+   double sum_ = 0;
+};
+
+
+// Compensated summation, in Neumaier's variant of Kahan's algorithm, which
+// also keeps the low bits of a sum when the value added is the larger.
+class kahan_sum {
+public:
+   void add(double x) noexcept {
+      const double t = sum_ + x;
+      if(std::abs(sum_) >= std::abs(x)) {
+         compensation_ += (sum_ - t) + x;
+      } else {
+         compensation_ += (x - t) + sum_;
+      }
+      sum_ = t;
+   }
+
+   void merge(const kahan_sum& s) noexcept {
+      add(s.sum_);
+      add(s.compensation_);
+   }
+
+   double value() const noexcept {
+      return sum_ + compensation_;
+   }
+
+private:
+   double sum_ = 0;
+   double compensation_ = 0;
+};
+
+
+// Exact summation of finite values: the sum is kept as non-overlapping
+// partial sums of increasing magnitude (Shewchuk, "Adaptive precision
+// floating-point arithmetic", 1997), and value() is the exact sum correctly
+// rounded. The result does not depend on the order of the values.
+class exact_sum {
+public:
+   void add(double x) {
+      std::size_t n = 0;
+      for(double y : partials_) {
+         if(std::abs(x) < std::abs(y)) {
+            std::swap(x, y);
+         }
+         const double high = x + y;
+         const double low = y - (high - x);
+         if(low != 0) {
+            partials_[n++] = low;
+         }
+         x = high;
+      }
+      partials_.resize(n);
+      partials_.push_back(x);
+   }
+
+   void merge(const exact_sum& s) {
+      for(double x : s.partials_) {
+         add(x);
+      }
+   }
+
+   double value() const noexcept {
+      if(partials_.empty()) {
+         return 0;
+      }
+      auto i = partials_.size() - 1;
+      double high = partials_[i], low = 0;
+      while(i > 0) {
+         const double x = high, y = partials_[--i];
+         high = x + y;
+         low = y - (high - x);
+         if(low != 0) {
+            break;
+         }
+      }
+      // Rounds half way cases by the sign of the partials below.
+      if(i > 0 && ((low < 0 && partials_[i - 1] < 0) || (low > 0 && partials_[i - 1] > 0))) {
+         const double y = low * 2, x = high + y;
+         if(y == x - high) {
+            high = x;
+         }
+      }
+      return high;
+   }
+
+private:
+   std::vector<double> partials_;
+};
+
+
+namespace detail {
+
+
+template <typename A>
+using indexed_sums = std::vector<std::pair<std::size_t, A>>;
+
+
+// Claims chunks of the source, numbered in source order, until it ends, and
+// sums the transformed values of every chunk on its own.
+template <accumulator A, typename R, typename Transform>
+task<indexed_sums<A>> reduce_chunks(thread_pool& pool, R& source, std::ranges::iterator_t<R>& current,
+                                    std::size_t& next_chunk, std::mutex& mutex, Transform& transform,
+                                    std::size_t chunk_size) {
+   co_await pool.schedule();
+   indexed_sums<A> sums;
+   std::vector<std::ranges::range_value_t<R>> chunk;
+   chunk.reserve(chunk_size);
+   while(true) {
+      std::size_t index = 0;
+      {
+         std::lock_guard lock{mutex};
+         for(; chunk.size() < chunk_size && current != std::ranges::end(source); ++current) {
+            chunk.push_back(*current);
+         }
+         if(chunk.empty()) {
+            break;
+         }
+         index = next_chunk++;
+      }
+      A sum;
+      for(const auto& x : chunk) {
+         sum.add(transform(x));
+      }
+      sums.emplace_back(index, std::move(sum));
+      chunk.clear();
+   }
+   co_return sums;
+}
+
+
+}  // namespace detail
+
+
+// Sum of transform(x) over the values of source, e.g. a std::generator, on
+// pool; transform is called concurrently. Workers take chunks of chunk_size
+// values from the source in turn, so that faster workers take more, and sum
+// each chunk with an A. The sums of the chunks are then merged pairwise in a
+// tree by chunk number: the grouping of the additions depends on chunk_size
+// only, and the result is the same for any number of threads and any timing.
+template <accumulator A = kahan_sum, std::ranges::input_range R, typename Transform>
+task<double> parallel_transform_reduce(thread_pool& pool, R source, Transform transform,
+                                       std::size_t chunk_size = 4096) {
+   chunk_size = std::max<std::size_t>(chunk_size, 1);
+   auto current = std::ranges::begin(source);
+   std::size_t next_chunk = 0;
+   std::mutex mutex;
+   std::vector<task<detail::indexed_sums<A>>> workers;
+   for(std::size_t i = 0; i < pool.size(); ++i) {
+      workers.push_back(
+          detail::reduce_chunks<A>(pool, source, current, next_chunk, mutex, transform, chunk_size));
+   }
+   auto results = co_await when_all(std::move(workers));
+
+   std::vector<A> sums(next_chunk);
+   for(auto& r : results) {
+      for(auto& [index, sum] : r) {
+         sums[index] = std::move(sum);
+      }
+   }
+   for(std::size_t step = 1; step < sums.size(); step *= 2) {
+      for(std::size_t i = 0; i + step < sums.size(); i += 2 * step) {
+         sums[i].merge(sums[i + step]);
+      }
+   }
+   co_return sums.empty() ? 0. : double(sums[0].value());
+}
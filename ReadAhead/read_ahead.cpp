@@ -0,0 +1,203 @@
+#include "cotask.hpp"
+#include "epoll_reactor.hpp"
+#include "read_ahead.hpp"
+#include "remote_data.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+constexpr std::size_t file_size = 64 << 20;
+constexpr std::uint32_t event_size = 64 << 10;
+const std::string file_name = "events.bin";
+
+
+// Event i is stored at the offset of its index, modulo the file size.
+auto event_source(std::uint64_t events) {
+   return std::views::iota(std::uint64_t{0}, events) | std::views::transform([](std::uint64_t i) {
+             return EventLocation{i * event_size % file_size, event_size};
+          });
+}
+
+using EventSource = decltype(event_source(0));
+
+
+bool valid(std::uint64_t index, std::span<const char> data) {
+   return data.size() == event_size && data.front() == char(index % (file_size / event_size));
+}
+
+
+struct Run {
+   epoll_reactor& reactor;
+   std::chrono::microseconds work;
+   unsigned finished = 0;
+   std::uint64_t next_event = 0;
+   std::chrono::steady_clock::duration stall_time{};
+};
+
+
+// Sleeping stands in for processing each event. It keeps the reactor free for
+// the reads in flight, as processing on other threads would.
+CoTask<Promise<>> consumer(Run& run, ReadAhead<EventSource>& stage) {
+   while(auto event = co_await stage.next()) {
+      if(!valid(event->index(), event->data())) {
+         std::cerr << "wrong data for event " << event->index() << '\n';
+         std::exit(EXIT_FAILURE);
+      }
+      co_await run.reactor.sleep_for(run.work);
+   }
+   ++run.finished;
+}
+
+
+// Reads each event only when it is needed.
+CoTask<Promise<>> direct_consumer(Run& run, RemoteDataConnection& connection, std::uint64_t events) {
+   std::vector<char> buffer(event_size);
+   while(run.next_event < events) {
+      auto index = run.next_event++;
+      auto t0 = std::chrono::steady_clock::now();
+      auto n = co_await connection.read(file_name, index * event_size % file_size, buffer);
+      run.stall_time += std::chrono::steady_clock::now() - t0;
+      if(!valid(index, {buffer.data(), n})) {
+         std::cerr << "wrong data for event " << index << '\n';
+         std::exit(EXIT_FAILURE);
+      }
+      co_await run.reactor.sleep_for(run.work);
+   }
+   ++run.finished;
+}
+
+
+// Wall time, stall time of all consumers and final read-ahead depth.
+struct Result {
+   double seconds;
+   double stall_seconds;
+   unsigned depth;
+   bool pinned;
+};
+
+
+Result run(const std::filesystem::path& socket_path, unsigned consumers, std::uint64_t events,
+           std::chrono::microseconds work, unsigned depth, bool adaptive) {
+   epoll_reactor reactor;
+   Run r{reactor, work};
+   std::vector<CoTask<Promise<>>> tasks;
+   auto t0 = std::chrono::steady_clock::now();
+
+   if(depth == 0) {
+      std::vector<std::unique_ptr<RemoteDataConnection>> connections;
+      for(unsigned c = 0; c < consumers; ++c) {
+         connections.push_back(std::make_unique<RemoteDataConnection>(reactor, socket_path));
+         tasks.push_back(direct_consumer(r, *connections.back(), events));
+         tasks.back().resume();
+      }
+      reactor.run_until([&] { return r.finished == consumers; });
+      std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+      return {dt.count(), std::chrono::duration<double>(r.stall_time).count(), 0, false};
+   }
+
+   ReadAhead<EventSource> stage{event_source(events), reactor, socket_path, file_name,
+                                {.max_depth = depth, .adaptive = adaptive, .max_event_size = event_size}};
+   for(unsigned c = 0; c < consumers; ++c) {
+      tasks.push_back(consumer(r, stage));
+      tasks.back().resume();
+   }
+   reactor.run_until([&] { return r.finished == consumers; });
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   auto stats = stage.stats();
+   if(stats.events != events) {
+      std::cerr << stats.events << " of " << events << " events\n";
+      std::exit(EXIT_FAILURE);
+   }
+   return {dt.count(), std::chrono::duration<double>(stats.stall_time).count(), stats.depth, stage.pinned()};
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::uint64_t events = argc > 1 ? std::stoull(argv[1]) : 1000;
+   const auto latency = std::chrono::microseconds{argc > 2 ? std::stoll(argv[2]) : 1000};
+   const auto work = std::chrono::microseconds{argc > 3 ? std::stoll(argv[3]) : 200};
+
+   auto root = std::filesystem::temp_directory_path() / ("read_ahead_" + std::to_string(::getpid()));
+   std::filesystem::create_directories(root);
+   {
+      std::ofstream out{root / file_name, std::ios::binary};
+      std::vector<char> data(event_size);
+      for(std::size_t e = 0; e < file_size / event_size; ++e) {
+         std::fill(data.begin(), data.end(), char(e));
+         out.write(data.data(), std::streamsize(data.size()));
+      }
+   }
+   auto socket_path = root / "server.sock";
+   RemoteDataServer server{root, socket_path, {.latency = latency, .bandwidth = 1024. * (1 << 20)}};
+
+   {
+      // Events arrive in source order, and the end of the source reaches every consumer.
+      epoll_reactor reactor;
+      ReadAhead<EventSource> stage{event_source(100), reactor, socket_path, file_name,
+                                   {.max_depth = 8, .max_event_size = event_size}};
+      std::vector<std::uint64_t> seen;
+      unsigned finished = 0;
+      bool data_valid = true;
+      auto check = [&]() -> CoTask<Promise<>> {
+         while(auto event = co_await stage.next()) {
+            data_valid &= valid(event->index(), event->data());
+            seen.push_back(event->index());
+         }
+         ++finished;
+      };
+      auto a = check();
+      auto b = check();
+      a.resume();
+      b.resume();
+      reactor.run_until([&] { return finished == 2; });
+      if(!data_valid || seen.size() != 100 || !std::ranges::is_sorted(seen)) {
+         std::filesystem::remove_all(root);
+         std::cerr << "read-ahead events are corrupt, missing or out of order\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::cout << events << " events of " << (event_size >> 10) << " kB, " << latency.count() << " us latency, "
+             << work.count() << " us work per event\n";
+   std::cout << std::setw(10) << "consumers" << std::setw(16) << "read-ahead" << std::setw(12) << "events/s"
+             << std::setw(16) << "stall us/event" << std::setw(12) << "stalled %" << std::setw(8) << "depth"
+             << '\n';
+
+   struct Mode {
+      const char* name;
+      unsigned depth;
+      bool adaptive;
+   };
+   bool pinned = false;
+   for(unsigned consumers : {1, 4}) {
+      for(auto [name, depth, adaptive] : {Mode{"none", 0, false}, Mode{"fixed 4", 4, false},
+                                          Mode{"fixed 16", 16, false}, Mode{"adaptive", 64, true}}) {
+         auto r = run(socket_path, consumers, events, work, depth, adaptive);
+         pinned = pinned || r.pinned;
+         std::cout << std::setw(10) << consumers << std::setw(16) << name << std::fixed << std::setprecision(0)
+                   << std::setw(12) << double(events) / r.seconds << std::setw(16)
+                   << r.stall_seconds / double(events) * 1e6 << std::setprecision(1) << std::setw(12)
+                   << 100. * r.stall_seconds / (consumers * r.seconds) << std::setw(8)
+                   << (depth ? std::to_string(r.depth) : "-") << '\n';
+      }
+   }
+   std::cout << "read-ahead buffers " << (pinned ? "locked" : "not locked") << " in memory\n";
+
+   std::filesystem::remove_all(root);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,335 @@
+#pragma once
+
+#include "remote_data.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+// Where the data of one event is found in the input file.
+struct EventLocation {
+   std::uint64_t offset;
+   std::uint32_t size;
+};
+
+
+// Read-ahead stage in front of an event source: any input range of
+// EventLocations, e.g. a std::generator. It keeps up to depth() reads in
+// flight over RemoteDataConnections, into a fixed set of buffers locked in
+// memory, and hands the events to downstream coroutines in source order with
+// co_await stage.next().
+//
+// The depth adapts to the consumers with Little's law: enough reads to cover
+// the observed read latency at the observed consumption rate, plus one ready
+// event per consumer. Everything runs on the thread driving the reactor.
+template <std::ranges::input_range Source>
+   requires std::convertible_to<std::ranges::range_reference_t<Source>, EventLocation>
+class ReadAhead {
+   struct Slot;
+
+public:
+   using clock = std::chrono::steady_clock;
+
+   struct Config {
+      unsigned max_depth = 64;
+      unsigned initial_depth = 2;
+      bool adaptive = true;
+      std::uint32_t max_event_size = 1 << 20;
+   };
+
+   struct Stats {
+      std::uint64_t events;
+      std::uint64_t stalls;
+      clock::duration stall_time;
+      unsigned depth;
+      double latency_us;
+   };
+
+   // Owns its slot until destroyed, which makes room for the next read.
+   class Event {
+   public:
+      Event(Event&& e) noexcept : stage_{e.stage_}, slot_{std::exchange(e.slot_, nullptr)} {
+      }
+
+      Event& operator=(Event&&) = delete;
+
+      ~Event() {
+         if(slot_) {
+            stage_->release(slot_);
+         }
+      }
+
+      // Position of the event in the source.
+      std::uint64_t index() const noexcept {
+         return slot_->index;
+      }
+
+      std::span<const char> data() const noexcept {
+         return {slot_->buffer, slot_->size};
+      }
+
+   private:
+      friend ReadAhead;
+
+      Event(ReadAhead& stage, Slot* slot) noexcept : stage_{&stage}, slot_{slot} {
+      }
+
+      ReadAhead* stage_;
+      Slot* slot_;
+   };
+
+   ReadAhead(Source source, epoll_reactor& reactor, const std::filesystem::path& socket_path, std::string path,
+             Config config)
+      : source_{std::move(source)}, next_location_{std::ranges::begin(source_)}, path_{std::move(path)},
+        config_{config}, depth_{config.adaptive ? config.initial_depth : config.max_depth} {
+      const std::size_t page = std::size_t(::sysconf(_SC_PAGESIZE));
+      buffer_size_ = (std::size_t(config_.max_event_size) + page - 1) / page * page;
+      pages_size_ = buffer_size_ * config_.max_depth;
+      auto* pages = ::mmap(nullptr, pages_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(pages == MAP_FAILED) {
+         throw std::system_error{errno, std::generic_category()};
+      }
+      pages_ = static_cast<char*>(pages);
+      // Without the privilege or the RLIMIT_MEMLOCK for it the pages stay unpinned.
+      pinned_ = ::mlock(pages_, pages_size_) == 0;
+
+      slots_.resize(config_.max_depth);
+      for(unsigned i = 0; i < config_.max_depth; ++i) {
+         slots_[i].buffer = pages_ + i * buffer_size_;
+         slots_[i].connection = std::make_unique<RemoteDataConnection>(reactor, socket_path);
+         free_.push_back(&slots_[i]);
+      }
+   }
+
+   ReadAhead(const ReadAhead&) = delete;
+   ReadAhead& operator=(const ReadAhead&) = delete;
+
+   // All events must have been released and no reads may be in flight.
+   ~ReadAhead() {
+      ::munmap(pages_, pages_size_);
+   }
+
+   // Yields std::optional<Event>, empty at the end of the source. Rethrows the
+   // error of a failed read.
+   auto next() noexcept {
+      return next_awaiter{*this, nullptr, {}, nullptr, {}};
+   }
+
+   bool pinned() const noexcept {
+      return pinned_;
+   }
+
+   unsigned depth() const noexcept {
+      return depth_;
+   }
+
+   Stats stats() const noexcept {
+      return {events_, stalls_, stall_time_, depth_, latency_ * 1e6};
+   }
+
+private:
+   struct Slot {
+      char* buffer = nullptr;
+      std::unique_ptr<RemoteDataConnection> connection;
+      std::uint64_t index = 0;
+      std::size_t size = 0;
+      bool ready = false;
+      std::exception_ptr error;
+      clock::time_point issued;
+      clock::time_point handed_out;
+   };
+
+   struct next_awaiter {
+      ReadAhead& stage_;
+      Slot* slot_ = nullptr;
+      std::coroutine_handle<> handle_;
+      next_awaiter* next_ = nullptr;
+      clock::time_point suspended_;
+
+      bool await_ready() {
+         stage_.on_demand();
+         if(!stage_.try_hand_out(*this)) {
+            return false;
+         }
+         stage_.issue();
+         return true;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) noexcept {
+         handle_ = handle;
+         suspended_ = clock::now();
+         (stage_.waiters_tail_ ? stage_.waiters_tail_->next_ : stage_.waiters_head_) = this;
+         stage_.waiters_tail_ = this;
+         ++stage_.waiting_;
+      }
+
+      std::optional<Event> await_resume() {
+         if(!slot_) {
+            return std::nullopt;
+         }
+         if(slot_->error) {
+            auto error = std::exchange(slot_->error, nullptr);
+            stage_.release(slot_);
+            std::rethrow_exception(error);
+         }
+         return Event{stage_, slot_};
+      }
+   };
+
+   // Fire-and-forget read; frees its own frame.
+   struct fetch_task {
+      struct promise_type {
+         fetch_task get_return_object() noexcept {
+            return {};
+         }
+
+         auto initial_suspend() noexcept {
+            return std::suspend_never{};
+         }
+
+         auto final_suspend() noexcept {
+            return std::suspend_never{};
+         }
+
+         void unhandled_exception() noexcept {
+            std::terminate();
+         }
+
+         void return_void() noexcept {
+         }
+      };
+   };
+
+   fetch_task fetch(Slot& slot, EventLocation location) {
+      try {
+         auto size = std::min(location.size, config_.max_event_size);
+         slot.size = co_await slot.connection->read(path_, location.offset, {slot.buffer, size});
+      } catch(...) {
+         slot.error = std::current_exception();
+      }
+      slot.ready = true;
+      auto latency = std::chrono::duration<double>(clock::now() - slot.issued).count();
+      latency_ = latency_ > 0. ? 0.8 * latency_ + 0.2 * latency : latency;
+      // May resume consumers, which may reuse the slot: nothing after this.
+      deliver();
+   }
+
+   bool exhausted() {
+      return next_location_ == std::ranges::end(source_);
+   }
+
+   void issue() {
+      while(pending_.size() < depth_ && !free_.empty() && !exhausted()) {
+         auto* slot = free_.back();
+         free_.pop_back();
+         EventLocation location = *next_location_;
+         ++next_location_;
+         slot->index = issued_++;
+         slot->ready = false;
+         slot->issued = clock::now();
+         pending_.push_back(slot);
+         fetch(*slot, location);
+      }
+   }
+
+   // Hands the oldest event to the awaiter if it has arrived, or the end of
+   // the source if nothing is left.
+   bool try_hand_out(next_awaiter& awaiter) {
+      if(pending_.empty()) {
+         return exhausted();
+      }
+      if(!pending_.front()->ready) {
+         return false;
+      }
+      awaiter.slot_ = pending_.front();
+      pending_.pop_front();
+      awaiter.slot_->handed_out = clock::now();
+      ++held_;
+      ++events_;
+      return true;
+   }
+
+   void deliver() {
+      while(waiters_head_) {
+         auto* w = waiters_head_;
+         if(!try_hand_out(*w)) {
+            return;
+         }
+         waiters_head_ = w->next_;
+         if(!waiters_head_) {
+            waiters_tail_ = nullptr;
+         }
+         --waiting_;
+         if(w->slot_) {
+            ++stalls_;
+            stall_time_ += clock::now() - w->suspended_;
+         }
+         issue();
+         w->handle_.resume();
+      }
+   }
+
+   void release(Slot* slot) {
+      // Time a consumer spent on the event, stalls excluded.
+      auto busy = std::chrono::duration<double>(clock::now() - slot->handed_out).count();
+      busy_ = busy_ > 0. ? 0.8 * busy_ + 0.2 * busy : busy;
+      --held_;
+      free_.push_back(slot);
+      issue();
+   }
+
+   // Called by every consumer asking for its next event.
+   void on_demand() {
+      if(config_.adaptive && latency_ > 0. && busy_ > 0.) {
+         // Every consumer in turn needs an event per busy_ seconds.
+         double consumers = double(held_ + waiting_ + 1);
+         double target = std::ceil(latency_ * consumers / busy_) + consumers;
+         depth_ = unsigned(std::clamp(target, 1., double(config_.max_depth)));
+      }
+      issue();
+   }
+
+   Source source_;
+   std::ranges::iterator_t<Source> next_location_;
+   const std::string path_;
+   const Config config_;
+
+   char* pages_ = nullptr;
+   std::size_t pages_size_ = 0;
+   std::size_t buffer_size_ = 0;
+   bool pinned_ = false;
+   std::vector<Slot> slots_;
+   std::vector<Slot*> free_;
+   // Reads in flight or arrived, in source order.
+   std::deque<Slot*> pending_;
+   next_awaiter* waiters_head_ = nullptr;
+   next_awaiter* waiters_tail_ = nullptr;
+
+   unsigned depth_;
+   unsigned held_ = 0;
+   unsigned waiting_ = 0;
+   std::uint64_t issued_ = 0;
+   // Smoothed read latency and consumer time per event, in seconds.
+   double latency_ = 0.;
+   double busy_ = 0.;
+
+   std::uint64_t events_ = 0;
+   std::uint64_t stalls_ = 0;
+   clock::duration stall_time_{};
+};
@@ -0,0 +1,173 @@
+#include "cotask.hpp"
+#include "epoll_reactor.hpp"
+#include "remote_data.hpp"
+#include "task.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+constexpr std::size_t file_size = 64 << 20;
+constexpr std::size_t chunk = 256 << 10;
+const std::string file_name = "data.bin";
+
+
+struct Reads {
+   unsigned issued = 0;
+   unsigned total;
+   unsigned failed = 0;
+   unsigned finished_readers = 0;
+};
+
+
+// One in-flight read at a time over its own connection, until all reads of
+// the run are issued. Failed reads are counted and not retried.
+CoTask<Promise<>> reader(RemoteDataConnection& connection, Reads& reads) {
+   std::vector<char> buffer(chunk);
+   while(reads.issued < reads.total) {
+      std::uint64_t offset = std::uint64_t(reads.issued++) * chunk % file_size;
+      try {
+         auto n = co_await connection.read(file_name, offset, buffer);
+         if(n != chunk || buffer[0] != char(offset / chunk)) {
+            std::cerr << "wrong data at " << offset << '\n';
+            std::exit(EXIT_FAILURE);
+         }
+      } catch(const std::system_error&) {
+         ++reads.failed;
+      }
+   }
+   ++reads.finished_readers;
+}
+
+
+// Returns MB/s and the fraction of failed reads.
+std::pair<double, double> run(const RemoteDataServer& server, unsigned in_flight, unsigned total) {
+   epoll_reactor reactor;
+   std::vector<std::unique_ptr<RemoteDataConnection>> connections;
+   for(unsigned i = 0; i < in_flight; ++i) {
+      connections.push_back(std::make_unique<RemoteDataConnection>(reactor, server.socket_path()));
+   }
+
+   Reads reads{.total = total};
+   std::vector<CoTask<Promise<>>> readers;
+   auto t0 = std::chrono::steady_clock::now();
+   for(auto& c : connections) {
+      readers.push_back(reader(*c, reads));
+      readers.back().resume();
+   }
+   reactor.run_until([&] { return reads.finished_readers == in_flight; });
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+   return {double(total - reads.failed) * chunk / (1 << 20) / dt.count(), double(reads.failed) / total};
+}
+
+
+// Clears ok on any wrong result.
+CoTask<Promise<>> check_reads(RemoteDataConnection& connection, bool& done, bool& ok) {
+   std::vector<char> buffer(4096);
+   auto n = co_await connection.read(file_name, 3 * chunk - 10, buffer);
+   ok &= n == buffer.size() && buffer[9] == 2 && buffer[10] == 3;
+   n = co_await connection.read(file_name, file_size - 100, buffer);
+   ok &= n == 100;
+   int missing = 0, outside = 0;
+   try {
+      co_await connection.read("missing.bin", 0, buffer);
+   } catch(const std::system_error& e) {
+      missing = e.code().value();
+   }
+   try {
+      co_await connection.read("../" + file_name, 0, buffer);
+   } catch(const std::system_error& e) {
+      outside = e.code().value();
+   }
+   ok &= missing == ENOENT && outside == EACCES;
+   done = true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const double bandwidth_mb = argc > 1 ? std::stod(argv[1]) : 256.;
+   const unsigned total = argc > 2 ? unsigned(std::stoul(argv[2])) : 128;
+
+   auto root = std::filesystem::temp_directory_path() / ("remote_data_" + std::to_string(::getpid()));
+   std::filesystem::create_directories(root);
+   {
+      // Every chunk is filled with its index.
+      std::ofstream out{root / file_name, std::ios::binary};
+      std::vector<char> data(chunk);
+      for(std::size_t c = 0; c < file_size / chunk; ++c) {
+         std::fill(data.begin(), data.end(), char(c));
+         out.write(data.data(), std::streamsize(data.size()));
+      }
+   }
+   auto socket_path = root / "server.sock";
+
+   {
+      RemoteDataServer server{root, socket_path, {.latency = 100us}};
+      epoll_reactor reactor;
+      RemoteDataConnection connection{reactor, socket_path};
+      bool done = false, ok = true;
+      auto check = check_reads(connection, done, ok);
+      check.resume();
+      reactor.run_until([&] { return done; });
+      if(!ok || server.stats().requests != 4 || server.stats().errors != 2 || server.accept_error() != 0) {
+         std::filesystem::remove_all(root);
+         std::cerr << "remote reads returned wrong data or errors\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   const std::vector<unsigned> depths{1, 2, 4, 8, 16, 32, 64};
+   std::cout << total << " reads of " << (chunk >> 10) << " kB, link of " << bandwidth_mb << " MB/s\n";
+   std::cout << "MB/s for reads in flight:\n";
+   std::cout << std::setw(12) << "latency us";
+   for(auto d : depths) {
+      std::cout << std::setw(8) << d;
+   }
+   std::cout << std::setw(10) << "needed" << std::setw(10) << "model" << '\n';
+
+   for(auto latency : {100us, 1000us, 5000us}) {
+      RemoteDataServer server{root, socket_path, {.latency = latency, .bandwidth = bandwidth_mb * (1 << 20)}};
+      std::cout << std::setw(12) << latency.count() << std::fixed << std::setprecision(0);
+      unsigned needed = 0;
+      for(auto d : depths) {
+         auto [mb_s, failed] = run(server, d, total);
+         std::cout << std::setw(8) << mb_s;
+         if(!needed && mb_s >= 0.9 * bandwidth_mb) {
+            needed = d;
+         }
+      }
+      // Enough reads to keep the link busy during the latency of the next one.
+      auto transfer = double(chunk) / (bandwidth_mb * (1 << 20));
+      auto model = 1 + std::ceil(std::chrono::duration<double>(latency).count() / transfer);
+      std::cout << std::setw(10) << (needed ? std::to_string(needed) : "-") << std::setw(10) << model << '\n';
+   }
+
+   {
+      constexpr double error_rate = 0.05;
+      RemoteDataServer server{root, socket_path, {.latency = 100us, .error_rate = error_rate}};
+      auto [mb_s, failed] = run(server, 8, 2000);
+      std::cout << std::setprecision(2) << "error rate " << error_rate << ": " << failed << " of the reads failed\n";
+      if(std::abs(failed - error_rate) > 0.02) {
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::filesystem::remove_all(root);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+#include "cotask.hpp"
+#include "epoll_reactor.hpp"
+#include "task.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <random>
+#include <span>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// Offline stand-in for remote storage: a server on a Unix domain socket
+// serving byte ranges of the files below a root directory, and a client
+// connection whose reads are awaitable from any coroutine, CoTask included.
+//
+// Each connection carries one request at a time; concurrent reads use one
+// connection each. The server adds a fixed latency to every request, shares
+// a link of limited bandwidth among all responses, and fails a random
+// fraction of the requests with EIO.
+
+
+// Wire format, in host byte order.
+struct RemoteRequest {
+   std::uint64_t id;
+   std::uint64_t offset;
+   std::uint32_t length;
+   std::uint32_t path_length;  // followed by the path
+};
+
+
+struct RemoteResponse {
+   std::uint64_t id;
+   std::int32_t status;  // 0 or an errno value
+   std::uint32_t length;  // followed by the data
+};
+
+
+namespace detail {
+
+
+// Returns false if the peer closed the connection before sending anything.
+inline task<bool> read_exact(epoll_reactor& reactor, int fd, void* data, std::size_t size) {
+   auto* p = static_cast<char*>(data);
+   std::size_t done = 0;
+   while(done < size) {
+      auto n = ::read(fd, p + done, size - done);
+      if(n > 0) {
+         done += std::size_t(n);
+      } else if(n == 0) {
+         if(done == 0) {
+            co_return false;
+         }
+         throw std::system_error{ECONNRESET, std::generic_category()};
+      } else if(errno == EAGAIN) {
+         co_await reactor.readable(fd);
+      } else if(errno != EINTR) {
+         throw std::system_error{errno, std::generic_category()};
+      }
+   }
+   co_return true;
+}
+
+
+inline task<> write_all(epoll_reactor& reactor, int fd, const void* data, std::size_t size) {
+   const auto* p = static_cast<const char*>(data);
+   std::size_t done = 0;
+   while(done < size) {
+      auto n = ::send(fd, p + done, size - done, MSG_NOSIGNAL);
+      if(n >= 0) {
+         done += std::size_t(n);
+      } else if(errno == EAGAIN) {
+         co_await reactor.writable(fd);
+      } else if(errno != EINTR) {
+         throw std::system_error{errno, std::generic_category()};
+      }
+   }
+}
+
+
+inline sockaddr_un unix_address(const std::filesystem::path& path) {
+   sockaddr_un address{};
+   address.sun_family = AF_UNIX;
+   const auto& s = path.native();
+   if(s.size() >= sizeof(address.sun_path)) {
+      throw std::system_error{ENAMETOOLONG, std::generic_category()};
+   }
+   std::copy(s.begin(), s.end(), address.sun_path);
+   return address;
+}
+
+
+inline int check(int result) {
+   if(result < 0) {
+      throw std::system_error{errno, std::generic_category()};
+   }
+   return result;
+}
+
+
+}  // namespace detail
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+class RemoteDataServer {
+public:
+   struct Config {
+      std::chrono::microseconds latency{1000};
+      double bandwidth = 0.;  // bytes per second, 0 for unlimited
+      double error_rate = 0.;
+      std::uint32_t seed = 1;
+   };
+
+   struct Stats {
+      std::uint64_t requests;
+      std::uint64_t errors;
+      std::uint64_t bytes;
+      std::uint64_t accept_errors;  // out of descriptors or memory, retried
+   };
+
+   // Serves on its own thread until destroyed.
+   RemoteDataServer(std::filesystem::path root, std::filesystem::path socket_path, Config config)
+      : root_{std::move(root)}, socket_path_{std::move(socket_path)}, config_{config}, rng_{config.seed} {
+      std::filesystem::remove(socket_path_);
+      listen_fd_ = detail::check(::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+      auto address = detail::unix_address(socket_path_);
+      detail::check(::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+      detail::check(::listen(listen_fd_, SOMAXCONN));
+      reactor_.add(listen_fd_);
+
+      thread_ = std::jthread{[this](std::stop_token stop) {
+         accept_loop_.resume();
+         reactor_.run(stop);
+      }};
+   }
+
+   RemoteDataServer(const RemoteDataServer&) = delete;
+   RemoteDataServer& operator=(const RemoteDataServer&) = delete;
+
+   ~RemoteDataServer() {
+      thread_.request_stop();
+      thread_.join();
+      for(auto& [path, fd] : files_) {
+         ::close(fd);
+      }
+      ::close(listen_fd_);
+      std::filesystem::remove(socket_path_);
+   }
+
+   const std::filesystem::path& socket_path() const noexcept {
+      return socket_path_;
+   }
+
+   Stats stats() const noexcept {
+      return {requests_.load(), errors_.load(), bytes_.load(), accept_errors_.load()};
+   }
+
+   // Errno value of the accept failure that stopped the server from taking
+   // new connections, 0 while it takes them.
+   int accept_error() const noexcept {
+      return accept_error_.load();
+   }
+
+private:
+   CoTask<Promise<>> accept() {
+      while(true) {
+         int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+         if(fd >= 0) {
+            reactor_.add(fd);
+            connections_.push_back(serve(fd));
+            connections_.back().resume();
+         } else if(errno == EAGAIN) {
+            co_await reactor_.readable(listen_fd_);
+         } else if(errno == EINTR || errno == ECONNABORTED) {
+            // A client that reset its connection before it was accepted.
+         } else if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+            // The connection stays queued: try again once some are closed.
+            ++accept_errors_;
+            co_await reactor_.sleep_for(std::chrono::milliseconds{10});
+         } else {
+            accept_error_ = errno;
+            co_return;
+         }
+      }
+   }
+
+   // Frames of closed connections are kept until the server is destroyed.
+   CoTask<Promise<>> serve(int fd) {
+      // Also closes the connection if the frame is destroyed with the server.
+      struct closer {
+         int fd_;
+
+         ~closer() {
+            ::close(fd_);
+         }
+      } socket{fd};
+
+      try {
+         RemoteRequest request;
+         while(co_await detail::read_exact(reactor_, fd, &request, sizeof(request))) {
+            std::string path(request.path_length, '\0');
+            co_await detail::read_exact(reactor_, fd, path.data(), path.size());
+            auto deadline = std::chrono::steady_clock::now() + config_.latency;
+
+            std::vector<char> data;
+            RemoteResponse response{request.id, read_range(path, request.offset, request.length, data), 0};
+            response.length = std::uint32_t(data.size());
+            ++requests_;
+            if(response.status) {
+               ++errors_;
+            }
+            bytes_ += data.size();
+
+            // Responses are sent in turn over a link of limited bandwidth.
+            if(config_.bandwidth > 0.) {
+               auto start = std::max(deadline, link_free_);
+               link_free_ = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                       std::chrono::duration<double>(double(data.size()) / config_.bandwidth));
+               deadline = link_free_;
+            }
+            co_await reactor_.sleep_until(deadline);
+
+            co_await detail::write_all(reactor_, fd, &response, sizeof(response));
+            co_await detail::write_all(reactor_, fd, data.data(), data.size());
+         }
+      } catch(const std::system_error&) {
+         // The client went away.
+      }
+   }
+
+   // Returns 0 or an errno value.
+   int read_range(const std::string& path, std::uint64_t offset, std::uint32_t length, std::vector<char>& data) {
+      if(std::bernoulli_distribution{config_.error_rate}(rng_)) {
+         return EIO;
+      }
+      std::filesystem::path relative{path};
+      if(relative.is_absolute() || std::find(relative.begin(), relative.end(), std::filesystem::path{".."}) != relative.end()) {
+         return EACCES;
+      }
+
+      auto [it, inserted] = files_.try_emplace(path, -1);
+      if(inserted) {
+         it->second = ::open((root_ / relative).c_str(), O_RDONLY | O_CLOEXEC);
+      }
+      if(it->second < 0) {
+         files_.erase(it);
+         return ENOENT;
+      }
+
+      data.resize(length);
+      std::size_t done = 0;
+      while(done < length) {
+         auto n = ::pread(it->second, data.data() + done, length - done, off_t(offset + done));
+         if(n < 0) {
+            return errno;
+         }
+         if(n == 0) {
+            break;
+         }
+         done += std::size_t(n);
+      }
+      data.resize(done);
+      return 0;
+   }
+
+   const std::filesystem::path root_;
+   const std::filesystem::path socket_path_;
+   const Config config_;
+
+   // Only used on the server thread.
+   epoll_reactor reactor_;
+   int listen_fd_ = -1;
+   std::mt19937 rng_;
+   std::unordered_map<std::string, int> files_;
+   std::chrono::steady_clock::time_point link_free_{};
+   CoTask<Promise<>> accept_loop_ = accept();
+   std::vector<CoTask<Promise<>>> connections_;
+
+   std::atomic<std::uint64_t> requests_{0};
+   std::atomic<std::uint64_t> errors_{0};
+   std::atomic<std::uint64_t> bytes_{0};
+   std::atomic<std::uint64_t> accept_errors_{0};
+   std::atomic<int> accept_error_{0};
+   // Last member, so the server thread is joined before the above go away.
+   std::jthread thread_;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Client side of one connection, driven by the reactor of the calling thread.
+class RemoteDataConnection {
+public:
+   RemoteDataConnection(epoll_reactor& reactor, const std::filesystem::path& socket_path) : reactor_{reactor} {
+      fd_ = detail::check(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+      auto address = detail::unix_address(socket_path);
+      if(::connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+         auto error = errno;
+         ::close(fd_);
+         throw std::system_error{error, std::generic_category()};
+      }
+      ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) | O_NONBLOCK);
+      reactor_.add(fd_);
+   }
+
+   RemoteDataConnection(const RemoteDataConnection&) = delete;
+   RemoteDataConnection& operator=(const RemoteDataConnection&) = delete;
+
+   ~RemoteDataConnection() {
+      reactor_.remove(fd_);
+      ::close(fd_);
+   }
+
+   // Reads up to buffer.size() bytes from offset of the file at path, relative
+   // to the server root, and returns the number of bytes read: fewer at the end
+   // of the file. Errors reported by the server are thrown as std::system_error.
+   // Only one read may be in flight per connection.
+   task<std::size_t> read(std::string path, std::uint64_t offset, std::span<char> buffer) {
+      RemoteRequest request{++last_id_, offset, std::uint32_t(buffer.size()), std::uint32_t(path.size())};
+      co_await detail::write_all(reactor_, fd_, &request, sizeof(request));
+      co_await detail::write_all(reactor_, fd_, path.data(), path.size());
+
+      RemoteResponse response;
+      if(!co_await detail::read_exact(reactor_, fd_, &response, sizeof(response))) {
+         throw std::system_error{ECONNRESET, std::generic_category()};
+      }
+      if(response.id != request.id || response.length > buffer.size()) {
+         throw std::system_error{EPROTO, std::generic_category()};
+      }
+      co_await detail::read_exact(reactor_, fd_, buffer.data(), response.length);
+      if(response.status) {
+         throw std::system_error{response.status, std::generic_category()};
+      }
+      co_return response.length;
+   }
+
+private:
+   epoll_reactor& reactor_;
+   int fd_ = -1;
+   std::uint64_t last_id_ = 0;
+};
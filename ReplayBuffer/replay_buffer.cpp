@@ -0,0 +1,127 @@
+#include <version>
+
+
+#ifdef __cpp_lib_generator
+#include "replay_buffer.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <generator>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <ranges>
+#include <string>
+#include <vector>
+
+
+struct Track {
+   double pt, eta, phi;
+   std::uint64_t id;
+};
+
+
+static_assert(std::ranges::forward_range<replay_buffer<std::generator<Track>>>);
+
+
+// Tracks, each costing about cost iterations of a fit.
+std::generator<Track> tracks(std::size_t n, unsigned cost) {
+   for(std::size_t i = 0; i < n; ++i) {
+      double x = double(i % 1000) * 1e-3 + 0.5, y = 0.;
+      for(unsigned k = 0; k < cost; ++k) {
+         y += std::sin(x + y) * 0.5;
+      }
+      co_yield Track{1. + std::abs(y) * 10., y - std::floor(y) - 0.5, x * 6.28, i};
+   }
+}
+
+
+// Three passes, as a multi-pass algorithm would make: mean pt, its spread and
+// the tracks above the mean.
+template <typename Source>
+std::vector<double> passes(Source source) {
+   double n = 0, sum = 0, squares = 0;
+   std::size_t above = 0;
+   for(const Track& t : source()) {
+      n += 1;
+      sum += t.pt;
+   }
+   const double mean = sum / n;
+   for(const Track& t : source()) {
+      squares += (t.pt - mean) * (t.pt - mean);
+   }
+   for(const Track& t : source()) {
+      above += t.pt > mean;
+   }
+   return {mean, std::sqrt(squares / n), double(above)};
+}
+
+
+// Milliseconds for the passes.
+template <typename F>
+double milliseconds(F f, std::vector<double>& results) {
+   auto t0 = std::chrono::steady_clock::now();
+   results = f();
+   std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+   return dt.count();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::size_t n = argc > 1 ? std::stoul(argv[1]) : 1 << 20;
+   const std::size_t memory_limit = argc > 2 ? std::stoul(argv[2]) : std::size_t{4} << 20;
+
+   std::cout << n << " tracks of " << sizeof(Track) << " bytes, 3 passes, ms\n";
+   std::cout << std::setw(12) << "fit cost" << std::setw(14) << "regenerate" << std::setw(14) << "replay"
+             << std::setw(22) << "replay, " + std::to_string(memory_limit >> 20) + " MB limit" << '\n';
+   std::cout << std::fixed << std::setprecision(1);
+   for(unsigned cost : {0u, 8u, 64u}) {
+      std::vector<double> regenerated, replayed, spilled;
+      const double regenerate_ms = milliseconds(
+          [&] {
+             return passes([&] { return tracks(n, cost); });
+          },
+          regenerated);
+
+      replay_buffer<std::generator<Track>>::Stats stats{};
+      const double replay_ms = milliseconds(
+          [&] {
+             replay_buffer buffer{tracks(n, cost), {.memory_limit = std::size_t(-1)}};
+             return passes([&]() -> auto& { return buffer; });
+          },
+          replayed);
+      const double spill_ms = milliseconds(
+          [&] {
+             replay_buffer buffer{tracks(n, cost), {.memory_limit = memory_limit}};
+             auto results = passes([&]() -> auto& { return buffer; });
+             stats = buffer.stats();
+             return results;
+          },
+          spilled);
+
+      std::cout << std::setw(12) << cost << std::setw(14) << regenerate_ms << std::setw(14) << replay_ms
+                << std::setw(22) << spill_ms << '\n';
+      if(replayed != regenerated || spilled != regenerated) {
+         std::cerr << "replayed tracks differ from the regenerated ones\n";
+         return EXIT_FAILURE;
+      }
+      if(cost == 0) {
+         std::cout << std::setw(12) << "" << stats.spilled_chunks << " of " << stats.chunks
+                   << " chunks spilled, " << stats.reloads << " chunk reloads\n";
+      }
+   }
+   return EXIT_SUCCESS;
+}
+
+
+#else
+
+
+#error std::generator IS NOT SUPPORTED
+
+
+#endif
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+// Records the values of a single-pass range, e.g. a std::generator, the first
+// time they are read, and replays them on every later pass: a replay_buffer is
+// a forward_range. Values are pulled from the source a chunk at a time, as far
+// as an iterator has gone.
+//
+// Values are stored in chunks of chunk_size. Once the chunks in memory exceed
+// memory_limit bytes, the oldest ones are written to an anonymous temporary
+// file in directory and read back a chunk at a time when replayed. Iterators
+// hold on to the chunk they are in, and only call into the buffer to change
+// chunks. Spilled chunks are read back into copies, so iterators return
+// values, not references. Not thread-safe.
+template <std::ranges::input_range R>
+   requires std::is_trivially_copyable_v<std::ranges::range_value_t<R>>
+class replay_buffer {
+public:
+   using value_type = std::ranges::range_value_t<R>;
+
+   struct Config {
+      std::size_t chunk_size = 4096;
+      std::size_t memory_limit = std::size_t{64} << 20;
+      std::filesystem::path directory = std::filesystem::temp_directory_path();
+   };
+
+   struct Stats {
+      std::size_t values;
+      std::size_t chunks;
+      std::size_t spilled_chunks;
+      std::size_t reloads;
+   };
+
+   class iterator {
+   public:
+      using iterator_concept = std::forward_iterator_tag;
+      using value_type = replay_buffer::value_type;
+      using difference_type = std::ptrdiff_t;
+
+      iterator() = default;
+
+      value_type operator*() const {
+         if(index_ - first_ >= size_) {
+            buffer_->locate(*this);
+         }
+         return values_[index_ - first_];
+      }
+
+      iterator& operator++() {
+         ++index_;
+         return *this;
+      }
+
+      iterator operator++(int) {
+         auto i = *this;
+         ++index_;
+         return i;
+      }
+
+      bool operator==(const iterator& other) const {
+         return index_ == other.index_;
+      }
+
+      friend bool operator==(const iterator& i, std::default_sentinel_t) {
+         return i.done();
+      }
+
+   private:
+      friend replay_buffer;
+
+      bool done() const {
+         return index_ - first_ >= size_ && !buffer_->available(index_);
+      }
+
+      iterator(replay_buffer* buffer, std::size_t index) : buffer_{buffer}, index_{index} {
+      }
+
+      replay_buffer* buffer_ = nullptr;
+      std::size_t index_ = 0;
+      // Values first_ to first_ + size_ of the buffer, in the chunk held.
+      mutable std::shared_ptr<const value_type[]> chunk_;
+      mutable const value_type* values_ = nullptr;
+      mutable std::size_t first_ = 0;
+      mutable std::size_t size_ = 0;
+   };
+
+   explicit replay_buffer(R source) : replay_buffer(std::move(source), Config{}) {
+   }
+
+   replay_buffer(R source, Config config) : source_{std::move(source)}, config_{std::move(config)} {
+      config_.chunk_size = std::max<std::size_t>(config_.chunk_size, 1);
+   }
+
+   replay_buffer(const replay_buffer&) = delete;
+   replay_buffer& operator=(const replay_buffer&) = delete;
+
+   ~replay_buffer() {
+      if(fd_ >= 0) {
+         ::close(fd_);
+      }
+   }
+
+   iterator begin() {
+      return {this, 0};
+   }
+
+   std::default_sentinel_t end() const noexcept {
+      return {};
+   }
+
+   // Reads the rest of the source.
+   void record() {
+      while(available(size_)) {
+      }
+   }
+
+   Stats stats() const noexcept {
+      return {size_, chunks_.size(), spilled_, reloads_};
+   }
+
+private:
+   struct Chunk {
+      std::shared_ptr<value_type[]> data;  // null once spilled
+      off_t offset = -1;
+   };
+
+   std::size_t chunk_bytes() const noexcept {
+      return config_.chunk_size * sizeof(value_type);
+   }
+
+   // Whether value i exists, pulling the chunks up to it from the source.
+   bool available(std::size_t i) {
+      while(i >= size_ && !done_) {
+         do {
+            if(!current_) {
+               current_.emplace(std::ranges::begin(source_));
+            } else {
+               ++*current_;
+            }
+            if(*current_ == std::ranges::end(source_)) {
+               done_ = true;
+            } else {
+               append(**current_);
+            }
+         } while(!done_ && size_ % config_.chunk_size != 0);
+      }
+      return i < size_;
+   }
+
+   void append(value_type value) {
+      if(size_ == chunks_.size() * config_.chunk_size) {
+         if((chunks_.size() - spilled_ + 1) * chunk_bytes() > config_.memory_limit && spilled_ < chunks_.size()) {
+            spill(chunks_[spilled_++]);
+         }
+         if(!spare_) {
+            spare_ = std::make_shared_for_overwrite<value_type[]>(config_.chunk_size);
+         }
+         chunks_.push_back({std::move(spare_)});
+      }
+      chunks_.back().data[size_ % config_.chunk_size] = value;
+      ++size_;
+   }
+
+   // Chunks are spilled in order and full.
+   void spill(Chunk& chunk) {
+      if(fd_ < 0) {
+         fd_ = ::open(config_.directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+         if(fd_ < 0) {
+            throw std::system_error{errno, std::generic_category(),
+                                    "replay_buffer: temporary file in " + config_.directory.string()};
+         }
+      }
+      chunk.offset = off_t(file_size_);
+      write(chunk.data.get(), chunk.offset);
+      file_size_ += chunk_bytes();
+      // Taken for the next chunk, unless an iterator still reads it.
+      if(chunk.data.use_count() == 1) {
+         spare_ = std::move(chunk.data);
+      }
+      chunk.data.reset();
+   }
+
+   void write(const value_type* data, off_t offset) {
+      auto p = reinterpret_cast<const char*>(data);
+      for(std::size_t done = 0; done < chunk_bytes();) {
+         auto n = ::pwrite(fd_, p + done, chunk_bytes() - done, offset + off_t(done));
+         if(n < 0) {
+            throw std::system_error{errno, std::generic_category(), "replay_buffer: write"};
+         }
+         done += std::size_t(n);
+      }
+   }
+
+   void read(value_type* data, off_t offset) {
+      auto p = reinterpret_cast<char*>(data);
+      for(std::size_t done = 0; done < chunk_bytes();) {
+         auto n = ::pread(fd_, p + done, chunk_bytes() - done, offset + off_t(done));
+         if(n <= 0) {
+            throw std::system_error{n < 0 ? errno : EIO, std::generic_category(), "replay_buffer: read"};
+         }
+         done += std::size_t(n);
+      }
+   }
+
+   // Points the iterator to the chunk of its value, which must exist.
+   void locate(const iterator& i) {
+      available(i.index_);
+      const auto c = i.index_ / config_.chunk_size;
+      if(chunks_[c].data) {
+         i.chunk_ = chunks_[c].data;
+      } else {
+         if(reloaded_ != c) {
+            // A copy still held by an iterator is left to it.
+            if(!reload_ || reload_.use_count() > 1) {
+               reload_ = std::make_shared_for_overwrite<value_type[]>(config_.chunk_size);
+            }
+            read(reload_.get(), chunks_[c].offset);
+            reloaded_ = c;
+            ++reloads_;
+         }
+         i.chunk_ = reload_;
+      }
+      i.values_ = i.chunk_.get();
+      i.first_ = c * config_.chunk_size;
+      i.size_ = std::min(config_.chunk_size, size_ - i.first_);
+   }
+
+   R source_;
+   Config config_;
+   std::optional<std::ranges::iterator_t<R>> current_;
+   bool done_ = false;
+   std::vector<Chunk> chunks_;
+   std::size_t size_ = 0;
+   std::size_t spilled_ = 0;
+   std::shared_ptr<value_type[]> spare_;
+
+   int fd_ = -1;
+   std::size_t file_size_ = 0;
+   std::shared_ptr<value_type[]> reload_;
+   std::size_t reloaded_ = std::size_t(-1);
+   std::size_t reloads_ = 0;
+};
@@ -0,0 +1,158 @@
+#include "cotask.hpp"
+#include "shared_task.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+
+// Single-shot event the shared task suspends on, so that all consumers
+// queue up before the result becomes available.
+class Trigger {
+public:
+   bool await_ready() const noexcept {
+      return false;
+   }
+
+   void await_suspend(std::coroutine_handle<> handle) noexcept {
+      waiting_ = handle;
+   }
+
+   void await_resume() const noexcept {
+   }
+
+   void fire() {
+      std::exchange(waiting_, nullptr).resume();
+   }
+
+private:
+   std::coroutine_handle<> waiting_;
+};
+
+
+shared_task<std::vector<double>> make_calibration(Trigger& trigger, std::size_t n) {
+   co_await trigger;
+
+   std::vector<double> constants(n);
+   std::iota(constants.begin(), constants.end(), 1.);
+   co_return constants;
+}
+
+
+shared_task<> make_nothing() {
+   co_return;
+}
+
+
+// Each consumer holds its own copy of the shared task.
+CoTask<Promise<>> consumer(shared_task<std::vector<double>> calibration, double& sum) {
+   const auto& constants = co_await calibration;
+   sum += constants.back();
+}
+
+
+CoTask<Promise<>> void_consumer(shared_task<> task, unsigned& count) {
+   co_await task;
+   ++count;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct FanOutTimes {
+   double queue_ns;
+   double wake_ns;
+   double ready_ns;
+   bool ok;
+};
+
+
+FanOutTimes fan_out(std::size_t awaiters, std::size_t repetitions) {
+   using clock = std::chrono::steady_clock;
+   constexpr std::size_t constants = 64;
+
+   clock::duration queue{}, wake{}, ready{};
+   bool ok = true;
+   for(std::size_t r = 0; r < repetitions; ++r) {
+      Trigger trigger;
+      auto calibration = make_calibration(trigger, constants);
+      double sum = 0.;
+
+      std::vector<CoTask<Promise<>>> consumers;
+      consumers.reserve(awaiters);
+      for(std::size_t i = 0; i < awaiters; ++i) {
+         consumers.push_back(consumer(calibration, sum));
+      }
+
+      // The first resume starts the shared task, which suspends on the trigger.
+      auto t0 = clock::now();
+      for(auto& c : consumers) {
+         c.resume();
+      }
+      auto t1 = clock::now();
+      ok &= !calibration.is_ready() && sum == 0.;
+
+      trigger.fire();
+      auto t2 = clock::now();
+      ok &= calibration.is_ready() && sum == double(awaiters * constants);
+
+      // Late consumers find the result ready and do not suspend.
+      std::vector<CoTask<Promise<>>> late;
+      late.reserve(awaiters);
+      for(std::size_t i = 0; i < awaiters; ++i) {
+         late.push_back(consumer(calibration, sum));
+      }
+      auto t3 = clock::now();
+      for(auto& c : late) {
+         c.resume();
+      }
+      auto t4 = clock::now();
+      ok &= sum == double(2 * awaiters * constants);
+
+      queue += t1 - t0;
+      wake += t2 - t1;
+      ready += t4 - t3;
+   }
+
+   auto per_awaiter = [&](clock::duration d) {
+      return std::chrono::duration<double, std::nano>(d).count() / double(repetitions * awaiters);
+   };
+   return {per_awaiter(queue), per_awaiter(wake), per_awaiter(ready), ok};
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main() {
+   {
+      auto task = make_nothing();
+      unsigned count{};
+      auto a = void_consumer(task, count);
+      auto b = void_consumer(task, count);
+      while(a.resume()) {
+      }
+      while(b.resume()) {
+      }
+      if(count != 2 || !task.is_ready()) {
+         std::cerr << "void shared_task did not complete both awaiters\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::cout << std::setw(10) << "awaiters" << std::setw(14) << "queue ns" << std::setw(14)
+             << "wake ns" << std::setw(14) << "ready ns" << '\n';
+   for(std::size_t awaiters : {1, 10, 100, 1000}) {
+      auto t = fan_out(awaiters, 200000 / awaiters);
+      std::cout << std::setw(10) << awaiters << std::fixed << std::setprecision(1) << std::setw(14)
+                << t.queue_ns << std::setw(14) << t.wake_ns << std::setw(14) << t.ready_ns << '\n';
+      if(!t.ok) {
+         std::cerr << "awaiters did not all see the shared result\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+#include <version>
+
+
+#ifdef __cpp_lib_generator
+#include "simd_batch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <generator>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+template <typename T>
+std::generator<T> sequence(T n) {
+   T x{};
+   while(x < n) {
+      co_yield x++;
+   }
+}
+
+
+// The same sequence, produced a batch at a time.
+template <typename T, std::size_t W>
+std::generator<const batch<T, W>&> batched_sequence(T n) {
+   using simd_type = typename batch<T, W>::simd_type;
+   // No vector is kept in the frame, as in batches().
+   const auto storage = std::make_unique<batch<T, W>>();
+   auto& b = *storage;
+   for(T x{}; x < n; x += T(W)) {
+      b.assign(simd_type([x](auto i) { return x + T(i); }), std::size_t(std::min(T(W), n - x)));
+      co_yield b;
+   }
+}
+
+
+// Results of the four kernels, compared between the ways of consuming.
+struct Results {
+   double sum;
+   std::pair<double, double> minmax;
+   double transformed_sum;
+   std::vector<std::uint64_t> bins;
+
+   bool operator==(const Results&) const = default;
+};
+
+
+constexpr double low = 0.;
+constexpr std::size_t bins = 100;
+constexpr std::size_t widths[] = {sse_width<double>, avx2_width<double>, avx512_width<double>};
+
+
+Results scalar(double n, std::vector<double>& rates) {
+   Results r{0., {std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest()}, 0.,
+             std::vector<std::uint64_t>(bins + 2)};
+   const double high = n * 0.9, scale = double(bins) / (high - low);
+
+   auto t0 = std::chrono::steady_clock::now();
+   for(auto x : sequence(n)) {
+      r.sum += x;
+   }
+   auto t1 = std::chrono::steady_clock::now();
+   for(auto x : sequence(n)) {
+      r.minmax.first = std::min(r.minmax.first, x);
+      r.minmax.second = std::max(r.minmax.second, x);
+   }
+   auto t2 = std::chrono::steady_clock::now();
+   for(auto x : sequence(n)) {
+      r.transformed_sum += 2. * x + 1.;
+   }
+   auto t3 = std::chrono::steady_clock::now();
+   for(auto x : sequence(n)) {
+      ++r.bins[!(x >= low) ? 0 : x >= high ? bins + 1 : std::min(bins - 1, std::size_t((x - low) * scale)) + 1];
+   }
+   auto t4 = std::chrono::steady_clock::now();
+
+   for(auto dt : {t1 - t0, t2 - t1, t3 - t2, t4 - t3}) {
+      rates.push_back(n / std::chrono::duration<double>(dt).count() / 1e6);
+   }
+   return r;
+}
+
+
+template <std::size_t W, typename Source>
+Results batched(double n, Source source, std::vector<double>& rates) {
+   Results r{0., {}, 0., std::vector<std::uint64_t>(bins + 2)};
+   const double high = n * 0.9;
+
+   auto t0 = std::chrono::steady_clock::now();
+   r.sum = sum(source(n));
+   auto t1 = std::chrono::steady_clock::now();
+   r.minmax = minmax(source(n));
+   auto t2 = std::chrono::steady_clock::now();
+   r.transformed_sum = sum(transform(source(n), [](auto x) { return 2. * x + 1.; }));
+   auto t3 = std::chrono::steady_clock::now();
+   fill_histogram(source(n), low, high, std::span{r.bins});
+   auto t4 = std::chrono::steady_clock::now();
+
+   for(auto dt : {t1 - t0, t2 - t1, t3 - t2, t4 - t3}) {
+      rates.push_back(n / std::chrono::duration<double>(dt).count() / 1e6);
+   }
+   return r;
+}
+
+
+// The last value below high lands in the last bin, not in the overflow, also
+// where rounding gives the number of bins, and NaN in the underflow.
+template <std::size_t W>
+bool edges_binned() {
+   for(auto [n, edge_low, edge_high] : {std::tuple{78, -10., -5.131}, std::tuple{64, -10., -3.997}}) {
+      const std::vector<double> values{std::nextafter(edge_high, edge_low), edge_high, edge_low,
+                                       std::nextafter(edge_low, -20.), std::numeric_limits<double>::quiet_NaN()};
+      std::vector<std::uint64_t> counts(std::size_t(n) + 2), expected(std::size_t(n) + 2);
+      fill_histogram(batches<double, W>(values), edge_low, edge_high, std::span{counts});
+      expected[0] = 2;
+      expected[1] = 1;
+      expected[std::size_t(n)] = 1;
+      expected[std::size_t(n) + 1] = 1;
+      if(counts != expected) {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   // Not a multiple of the widths, to have tails.
+   const double n = argc > 1 ? std::stod(argv[1]) : double((1 << 22) + 3);
+
+   const bool edges = [&]<std::size_t... I>(std::index_sequence<I...>) {
+      return (edges_binned<widths[I]>() && ...);
+   }(std::make_index_sequence<3>{});
+   if(!edges) {
+      std::cerr << "values at the edges of the axis or NaN go to the wrong bins\n";
+      return EXIT_FAILURE;
+   }
+
+   std::vector<std::vector<double>> rates(7);
+   const auto expected = scalar(n, rates[0]);
+   std::vector<Results> results;
+   [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (results.push_back(batched<widths[I]>(
+          n, [](double n) { return batches<double, widths[I]>(sequence(n)); }, rates[1 + I])),
+       ...);
+      (results.push_back(batched<widths[I]>(n, batched_sequence<double, widths[I]>, rates[4 + I])), ...);
+   }(std::make_index_sequence<3>{});
+
+   std::cout << std::size_t(n) << " doubles, M elements/s\n";
+   std::cout << std::setw(16) << "" << std::setw(10) << "scalar" << std::setw(30) << "batches(sequence(n))"
+             << std::setw(30) << "batched_sequence(n)" << '\n';
+   std::cout << std::setw(16) << "kernel" << std::setw(10) << "";
+   for(int source = 0; source < 2; ++source) {
+      for(auto w : widths) {
+         std::cout << std::setw(10) << "W = " + std::to_string(w);
+      }
+   }
+   std::cout << '\n';
+   const char* kernels[] = {"sum", "min/max", "transform+sum", "histogram"};
+   for(std::size_t k = 0; k < 4; ++k) {
+      std::cout << std::setw(16) << kernels[k] << std::fixed << std::setprecision(0);
+      for(const auto& r : rates) {
+         std::cout << std::setw(10) << r[k];
+      }
+      std::cout << '\n';
+   }
+
+   if(std::count(results.begin(), results.end(), expected) != std::ptrdiff_t(results.size())) {
+      std::cerr << "batched results differ from the scalar ones\n";
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
+
+
+#else
+
+
+#error std::generator IS NOT SUPPORTED
+
+
+#endif
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <experimental/simd>
+#include <generator>
+#include <limits>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <utility>
+
+
+namespace stdx = std::experimental;
+
+
+// Widths of SSE, AVX2 and AVX-512 registers, in elements of T.
+template <typename T>
+constexpr std::size_t sse_width = 16 / sizeof(T);
+template <typename T>
+constexpr std::size_t avx2_width = 32 / sizeof(T);
+template <typename T>
+constexpr std::size_t avx512_width = 64 / sizeof(T);
+
+
+// W consecutive values of a sequence, aligned for vector loads. The last
+// batch of a sequence may hold fewer: the lanes beyond size() are zero and
+// mask() tells the valid ones.
+template <typename T, std::size_t W>
+class batch {
+public:
+   using simd_type = stdx::simd<T, stdx::simd_abi::deduce_t<T, W>>;
+   using mask_type = typename simd_type::mask_type;
+
+   static constexpr std::size_t width = W;
+
+   std::size_t size() const noexcept {
+      return size_;
+   }
+
+   bool full() const noexcept {
+      return size_ == W;
+   }
+
+   simd_type load() const noexcept {
+      return simd_type{values_, stdx::vector_aligned};
+   }
+
+   mask_type mask() const noexcept {
+      return index() < simd_type(T(size_));
+   }
+
+   std::span<const T> values() const noexcept {
+      return {values_, size_};
+   }
+
+   void push_back(T x) noexcept {
+      values_[size_++] = x;
+   }
+
+   void clear() noexcept {
+      size_ = 0;
+   }
+
+   // Takes the first size lanes of v.
+   void assign(simd_type v, std::size_t size) noexcept {
+      size_ = size;
+      stdx::where(!mask(), v) = T{};
+      v.copy_to(values_, stdx::vector_aligned);
+   }
+
+private:
+   static simd_type index() noexcept {
+      return simd_type([](auto i) { return T(i); });
+   }
+
+   alignas(stdx::memory_alignment_v<simd_type>) T values_[W]{};
+   std::size_t size_ = 0;
+};
+
+
+// Packs the values of a range, e.g. a std::generator<T>, into batches.
+template <typename T, std::size_t W, std::ranges::input_range R>
+std::generator<const batch<T, W>&> batches(R values) {
+   // Not in the coroutine frame, which is aligned for operator new only, not
+   // for the vector loads.
+   const auto storage = std::make_unique<batch<T, W>>();
+   auto& b = *storage;
+   for(auto&& x : values) {
+      b.push_back(T(x));
+      if(b.full()) {
+         co_yield b;
+         b.clear();
+      }
+   }
+   if(b.size() > 0) {
+      b.assign(b.load(), b.size());
+      co_yield b;
+   }
+}
+
+
+// Kernels consuming batches. The zero lanes of a tail do not change a sum, the
+// other kernels mask them.
+template <typename T, std::size_t W>
+T sum(std::generator<const batch<T, W>&> batches) {
+   typename batch<T, W>::simd_type total = 0;
+   for(const auto& b : batches) {
+      total += b.load();
+   }
+   return stdx::reduce(total);
+}
+
+
+template <typename T, std::size_t W>
+std::pair<T, T> minmax(std::generator<const batch<T, W>&> batches) {
+   using simd_type = typename batch<T, W>::simd_type;
+   simd_type low = std::numeric_limits<T>::max();
+   simd_type high = std::numeric_limits<T>::lowest();
+   for(const auto& b : batches) {
+      const auto v = b.load();
+      const auto valid = b.mask();
+      stdx::where(valid, low) = stdx::min(low, v);
+      stdx::where(valid, high) = stdx::max(high, v);
+   }
+   return {stdx::hmin(low), stdx::hmax(high)};
+}
+
+
+// Applies f to the simd_type of every batch, keeping the tail lanes zero.
+template <typename T, std::size_t W, typename F>
+std::generator<const batch<T, W>&> transform(std::generator<const batch<T, W>&> batches, F f) {
+   // Not in the frame, as in batches().
+   const auto storage = std::make_unique<batch<T, W>>();
+   auto& out = *storage;
+   for(const auto& b : batches) {
+      out.assign(f(b.load()), b.size());
+      co_yield out;
+   }
+}
+
+
+// Adds the values to counts of bins.size() - 2 equal bins over [low, high),
+// with underflow first and overflow last; NaN counts as underflow. The bin
+// numbers are computed for all lanes at once.
+template <typename T, std::size_t W>
+void fill_histogram(std::generator<const batch<T, W>&> batches, T low, T high, std::span<std::uint64_t> bins) {
+   using simd_type = typename batch<T, W>::simd_type;
+   using index_type = stdx::rebind_simd_t<std::int32_t, simd_type>;
+   const auto n = std::int32_t(bins.size() - 2);
+   const simd_type scale = T(n) / (high - low);
+   for(const auto& b : batches) {
+      const auto v = b.load();
+      // Rounding may put values just below high at n: they go to the last
+      // bin. All lanes are in range before the conversion, which does not
+      // take out-of-range values or NaN.
+      auto x = stdx::min(stdx::floor((v - low) * scale), simd_type(T(n - 1)));
+      stdx::where(!(v >= low), x) = T(-1);
+      stdx::where(v >= high, x) = T(n);
+      auto i = stdx::static_simd_cast<index_type>(x) + 1;
+      for(std::size_t lane = 0; lane < b.size(); ++lane) {
+         ++bins[std::size_t(i[lane])];
+      }
+   }
+}
@@ -0,0 +1,183 @@
+#include "cotask.hpp"
+#include "soa.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <experimental/simd>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+
+namespace stdx = std::experimental;
+
+
+// Hit of a reconstruction step, as a struct
+struct Hit {
+   float x, y, z;
+   float energy;
+   float et;  // output
+};
+
+
+// and as fields of an soa.
+struct x : soa_field<float> {};
+struct y : soa_field<float> {};
+struct z : soa_field<float> {};
+struct energy : soa_field<float> {};
+struct et : soa_field<float> {};
+using Hits = soa<x, y, z, energy, et>;
+using HitsView = soa_view<x, y, z, energy, et>;
+
+// A field larger than a cache line.
+struct samples : soa_field<std::array<float, 32>> {};
+
+
+// Every column starts on a cache line.
+template <typename... Fields>
+bool aligned(const soa<Fields...>& s) {
+   return ((reinterpret_cast<std::uintptr_t>(s.template get<Fields>().data()) % soa<Fields...>::alignment == 0) &&
+           ...);
+}
+
+
+// Transverse energy of each hit.
+float transverse(float x, float y, float z, float e) {
+   const float r = std::sqrt(x * x + y * y);
+   return e * r / std::sqrt(r * r + z * z);
+}
+
+
+void kernel(std::span<Hit> hits) {
+   for(auto& h : hits) {
+      h.et = transverse(h.x, h.y, h.z, h.energy);
+   }
+}
+
+
+void kernel(HitsView hits) {
+   auto xs = hits.get<x>(), ys = hits.get<y>(), zs = hits.get<z>(), es = hits.get<energy>();
+   auto out = hits.get<et>();
+   for(std::size_t i = 0; i < hits.size(); ++i) {
+      out[i] = transverse(xs[i], ys[i], zs[i], es[i]);
+   }
+}
+
+
+// Explicitly vectorized. Views must start on a cache line.
+void simd_kernel(HitsView hits) {
+   using V = stdx::native_simd<float>;
+   auto xs = hits.get<x>(), ys = hits.get<y>(), zs = hits.get<z>(), es = hits.get<energy>();
+   auto out = hits.get<et>();
+   std::size_t i = 0;
+   for(; i + V::size() <= hits.size(); i += V::size()) {
+      V vx{&xs[i], stdx::vector_aligned}, vy{&ys[i], stdx::vector_aligned};
+      V vz{&zs[i], stdx::vector_aligned}, ve{&es[i], stdx::vector_aligned};
+      const V r = stdx::sqrt(vx * vx + vy * vy);
+      const V t = ve * r / stdx::sqrt(r * r + vz * vz);
+      t.copy_to(&out[i], stdx::vector_aligned);
+   }
+   for(; i < hits.size(); ++i) {
+      out[i] = transverse(xs[i], ys[i], zs[i], es[i]);
+   }
+}
+
+
+std::span<Hit> slice(std::span<Hit> hits, std::size_t first, std::size_t count) {
+   return hits.subspan(first, count);
+}
+
+
+HitsView slice(HitsView hits, std::size_t first, std::size_t count) {
+   return hits.subview(first, count);
+}
+
+
+// Hands out the hits in chunks, as a reconstruction stage would.
+template <typename Chunk>
+CoTask<Promise<Chunk>> chunks(Chunk hits, std::size_t chunk_size) {
+   for(std::size_t first = 0; first < hits.size(); first += chunk_size) {
+      co_yield slice(hits, first, std::min(chunk_size, hits.size() - first));
+   }
+}
+
+
+// Nanoseconds per hit and pass.
+template <typename Chunk, typename Kernel>
+double run(Chunk hits, std::size_t chunk_size, unsigned passes, Kernel kernel) {
+   auto t0 = std::chrono::steady_clock::now();
+   for(unsigned p = 0; p < passes; ++p) {
+      auto c = chunks(hits, chunk_size);
+      while(c.resume()) {
+         kernel(c.get_value());
+      }
+   }
+   std::chrono::duration<double, std::nano> dt = std::chrono::steady_clock::now() - t0;
+   return dt.count() / double(passes) / double(hits.size());
+}
+
+
+bool same(float a, float b) {
+   return std::abs(a - b) <= 1e-5f * std::abs(a) + 1e-6f;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::size_t n = argc > 1 ? std::stoul(argv[1]) : 1 << 20;
+   const unsigned passes = argc > 2 ? unsigned(std::stoul(argv[2])) : 20;
+
+   std::vector<Hit> aos;
+   Hits hits;
+   std::mt19937 engine{1};
+   std::uniform_real_distribution<float> position{-100.f, 100.f};
+   std::exponential_distribution<float> e{0.1f};
+   for(std::size_t i = 0; i < n; ++i) {
+      Hit h{position(engine), position(engine), position(engine), e(engine), 0.f};
+      aos.push_back(h);
+      hits.push_back(h.x, h.y, h.z, h.energy, 0.f);
+   }
+   soa<samples> pulses;
+   pulses.push_back({1.f});
+   pulses.resize(3);
+   if(!aligned(hits) || !aligned(pulses) || pulses.get<samples>()[0][0] != 1.f || pulses.get<samples>()[2][0] != 0.f) {
+      std::cerr << "columns not aligned or not kept\n";
+      return EXIT_FAILURE;
+   }
+
+   std::cout << n << " hits, " << stdx::native_simd<float>::size() << " floats per vector\n";
+   std::cout << std::setw(10) << "chunk" << std::setw(12) << "AoS" << std::setw(12) << "SoA" << std::setw(12)
+             << "SoA simd" << "   ns/hit\n";
+
+   for(std::size_t chunk_size : {n, std::size_t(4096), std::size_t(256)}) {
+      auto aos_ns = run(std::span{aos}, chunk_size, passes, [](std::span<Hit> c) { kernel(c); });
+      auto soa_ns = run(hits.view(), chunk_size, passes, [](HitsView c) { kernel(c); });
+      for(std::size_t i = 0; i < n; ++i) {
+         if(!same(aos[i].et, hits.get<et>()[i])) {
+            std::cerr << "hit " << i << ": AoS " << aos[i].et << ", SoA " << hits.get<et>()[i] << '\n';
+            return EXIT_FAILURE;
+         }
+      }
+      std::fill(hits.get<et>().begin(), hits.get<et>().end(), 0.f);
+      auto simd_ns = run(hits.view(), chunk_size, passes, [](HitsView c) { simd_kernel(c); });
+      for(std::size_t i = 0; i < n; ++i) {
+         if(!same(aos[i].et, hits.get<et>()[i])) {
+            std::cerr << "hit " << i << ": AoS " << aos[i].et << ", SoA simd " << hits.get<et>()[i] << '\n';
+            return EXIT_FAILURE;
+         }
+      }
+
+      std::cout << std::setw(10) << chunk_size << std::fixed << std::setprecision(3) << std::setw(12) << aos_ns
+                << std::setw(12) << soa_ns << std::setw(12) << simd_ns << '\n';
+   }
+
+   return EXIT_SUCCESS;
+}
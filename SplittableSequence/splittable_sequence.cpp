@@ -0,0 +1,86 @@
+#include <version>
+
+
+#ifdef __cpp_lib_generator
+#include "splittable_sequence.hpp"
+#include "sync_wait.hpp"
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+
+using T = std::uint64_t;
+
+
+// Some work per value: a hash, of which the top bits are kept.
+constexpr auto transform = [](T x) { return (x * 0x9E3779B97F4A7C15) >> 40; };
+constexpr auto plus = [](T a, T b) { return a + b; };
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const T n = argc > 1 ? std::stoull(argv[1]) : 1'000'000'000;
+
+   // Splitting in the middle of a pass shortens it.
+   {
+      sequence<int> s{10};
+      int sum = 0;
+      sequence<int> second{0};
+      for(int x : s) {
+         sum += x;
+         if(x == 3) {
+            second = s.split();
+         }
+      }
+      for(int x : second) {
+         sum += x;
+      }
+      if(sum != 45 || s.remaining() != 0 || second.remaining() != 0) {
+         std::cerr << "split sequences do not add up\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   auto t0 = std::chrono::steady_clock::now();
+   T expected = 0;
+   for(auto x : sequence<T>{n}) {
+      expected += transform(x);
+   }
+   std::chrono::duration<double> serial = std::chrono::steady_clock::now() - t0;
+
+   std::cout << n << " values, transform-reduce\n";
+   std::cout << std::setw(12) << "threads" << std::setw(12) << "seconds" << std::setw(16) << "M values/s"
+             << std::setw(10) << "speedup" << '\n';
+   std::cout << std::fixed << std::setprecision(2);
+   std::cout << std::setw(12) << "serial" << std::setw(12) << serial.count() << std::setw(16)
+             << double(n) / serial.count() / 1e6 << std::setw(10) << 1. << '\n';
+
+   for(unsigned threads = 1; threads <= std::max(4u, std::thread::hardware_concurrency()); threads *= 2) {
+      thread_pool pool{threads};
+      t0 = std::chrono::steady_clock::now();
+      T sum = sync_wait(split_transform_reduce(pool, sequence<T>{n}, T{0}, plus, transform));
+      std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+      std::cout << std::setw(12) << threads << std::setw(12) << dt.count() << std::setw(16)
+                << double(n) / dt.count() / 1e6 << std::setw(10) << serial.count() / dt.count() << '\n';
+      if(sum != expected) {
+         std::cerr << threads << " threads: sum differs from the serial one\n";
+         return EXIT_FAILURE;
+      }
+   }
+   return EXIT_SUCCESS;
+}
+
+
+#else
+
+
+#error std::generator IS NOT SUPPORTED
+
+
+#endif
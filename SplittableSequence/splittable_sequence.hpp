@@ -0,0 +1,121 @@
+#pragma once
+
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <concepts>
+#include <cstddef>
+#include <generator>
+#include <optional>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+
+// A producer that can hand off part of the values it has left, for parallel
+// consumption. begin() starts a pass over the values left, as a generator,
+// and values consumed by a pass are not produced again. split() moves the
+// second half of the values left into a new producer; in the middle of a pass
+// it shortens that pass.
+template <typename S>
+concept splittable_range = std::ranges::input_range<S> && std::movable<S> && requires(S& s) {
+   { s.remaining() } -> std::convertible_to<std::size_t>;
+   { s.split() } -> std::same_as<S>;
+};
+
+
+// The values first, first + 1, ... last - 1.
+template <std::integral T>
+class sequence {
+public:
+   explicit sequence(T n) : sequence(T{}, n) {
+   }
+
+   sequence(T first, T last) : next_{first}, last_{last} {
+   }
+
+   // A moved sequence starts a new pass.
+   sequence(sequence&& s) noexcept : next_{s.next_}, last_{s.last_} {
+   }
+
+   sequence& operator=(sequence&& s) noexcept {
+      values_.reset();
+      next_ = s.next_;
+      last_ = s.last_;
+      return *this;
+   }
+
+   std::size_t remaining() const noexcept {
+      return next_ < last_ ? std::size_t(last_ - next_) : 0;
+   }
+
+   sequence split() noexcept {
+      const T middle = next_ + T(remaining() / 2);
+      sequence second{middle, last_};
+      last_ = middle;
+      return second;
+   }
+
+   auto begin() {
+      values_.emplace(produce());
+      return values_->begin();
+   }
+
+   auto end() noexcept {
+      return std::default_sentinel;
+   }
+
+private:
+   // Reads last_ before every value, so that split() shortens a pass.
+   std::generator<T> produce() {
+      while(next_ < last_) {
+         co_yield next_++;
+      }
+   }
+
+   T next_;
+   T last_;
+   std::optional<std::generator<T>> values_;
+};
+
+
+static_assert(splittable_range<sequence<int>>);
+
+
+// reduce(init, transform(x)...) over the values of range on pool, by lazy
+// binary splitting: every grain values, a part checks for idle workers and,
+// if there are some, splits in two parts running in parallel. Parts that are
+// too small to split run to the end. reduce must be associative and
+// commutative, and init its identity; the grouping depends on timing.
+template <splittable_range S, typename T, typename Reduce, typename Transform>
+task<T> split_transform_reduce(thread_pool& pool, S range, T init, Reduce reduce, Transform transform,
+                               std::size_t grain = 1 << 14) {
+   co_await pool.schedule();
+   T result = init;
+   bool split = false;
+   std::size_t n = 0;
+   for(auto&& x : range) {
+      result = reduce(std::move(result), transform(std::forward<decltype(x)>(x)));
+      if(++n == grain) {
+         n = 0;
+         if(pool.idle() > 0 && range.remaining() >= 2 * grain) {
+            split = true;
+            break;
+         }
+      }
+   }
+   if(!split) {
+      co_return result;
+   }
+
+   std::vector<task<T>> parts;
+   auto second = range.split();
+   parts.push_back(split_transform_reduce(pool, std::move(range), init, reduce, transform, grain));
+   parts.push_back(split_transform_reduce(pool, std::move(second), init, reduce, transform, grain));
+   auto results = co_await when_all(std::move(parts));
+   for(auto& r : results) {
+      result = reduce(std::move(result), std::move(r));
+   }
+   co_return result;
+}
@@ -0,0 +1,111 @@
+#include "shared_task.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+task<int> inline_value(int x) {
+   co_return x;
+}
+
+
+// Completes on a pool thread while the caller sleeps in sync_wait.
+task<int> pooled_value(thread_pool& pool, int x) {
+   co_await pool.schedule();
+   co_return x;
+}
+
+
+task<int> nested_value(thread_pool& pool, int x) {
+   int y = co_await pooled_value(pool, x);
+   co_return y + co_await pooled_value(pool, x);
+}
+
+
+task<> pooled_throw(thread_pool& pool) {
+   co_await pool.schedule();
+   throw std::runtime_error{"thrown on a pool thread"};
+}
+
+
+shared_task<std::string> shared_name(thread_pool& pool) {
+   co_await pool.schedule();
+   co_return "calibration";
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename F>
+void measure(const char* name, unsigned iterations, F&& round_trip) {
+   using clock = std::chrono::steady_clock;
+
+   std::vector<double> ns;
+   ns.reserve(iterations);
+   for(unsigned i = 0; i < iterations; ++i) {
+      auto t0 = clock::now();
+      round_trip(int(i));
+      ns.push_back(std::chrono::duration<double, std::nano>(clock::now() - t0).count());
+   }
+   std::sort(ns.begin(), ns.end());
+
+   auto at = [&](double q) { return ns[std::size_t(q * double(ns.size() - 1))]; };
+   std::cout << std::setw(22) << name << std::fixed << std::setprecision(0) << std::setw(12) << at(0.5)
+             << std::setw(12) << at(0.9) << std::setw(12) << at(0.99) << '\n';
+}
+
+
+int main(int argc, char* argv[]) {
+   const unsigned iterations = argc > 1 ? unsigned(std::stoul(argv[1])) : 100000;
+   thread_pool pool{1};
+
+   auto name = shared_name(pool);
+   const std::string& ref = sync_wait(name);
+   if(sync_wait(inline_value(1)) != 1 || sync_wait(pooled_value(pool, 2)) != 2 ||
+      sync_wait(nested_value(pool, 3)) != 6 || &ref != &sync_wait(name) || ref != "calibration") {
+      std::cerr << "sync_wait returned a wrong result\n";
+      return EXIT_FAILURE;
+   }
+
+   bool thrown = false;
+   try {
+      sync_wait(pooled_throw(pool));
+   } catch(const std::runtime_error&) {
+      thrown = true;
+   }
+   if(!thrown) {
+      std::cerr << "sync_wait did not rethrow\n";
+      return EXIT_FAILURE;
+   }
+
+   std::cout << std::setw(22) << "round trip" << std::setw(12) << "p50 ns" << std::setw(12) << "p90 ns"
+             << std::setw(12) << "p99 ns" << '\n';
+
+   measure("inline", iterations, [](int i) {
+      if(sync_wait(inline_value(i)) != i) {
+         std::abort();
+      }
+   });
+
+   measure("thread pool hop", iterations, [&](int i) {
+      if(sync_wait(pooled_value(pool, i)) != i) {
+         std::abort();
+      }
+   });
+
+   measure("two hops, nested", iterations, [&](int i) {
+      if(sync_wait(nested_value(pool, i)) != 2 * i) {
+         std::abort();
+      }
+   });
+
+   return EXIT_SUCCESS;
+}
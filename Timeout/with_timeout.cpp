@@ -0,0 +1,208 @@
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "timer_queue.hpp"
+#include "when_all.hpp"
+#include "with_timeout.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+// Live frames of the operations below, to check that losers are freed.
+std::atomic<int> live_frames{0};
+
+
+struct FrameCounter {
+   FrameCounter() {
+      ++live_frames;
+   }
+
+   ~FrameCounter() {
+      --live_frames;
+   }
+};
+
+
+task<int> inline_value(int x) {
+   FrameCounter counter;
+   co_return x;
+}
+
+
+task<int> pooled_value(thread_pool& pool, int x) {
+   FrameCounter counter;
+   co_await pool.schedule();
+   co_return x;
+}
+
+
+task<int> slow_value(timer_queue& timers, int x, std::chrono::milliseconds delay) {
+   FrameCounter counter;
+   co_await timers.sleep_for(delay);
+   co_return x;
+}
+
+
+task<> slow_throw(timer_queue& timers) {
+   FrameCounter counter;
+   co_await timers.sleep_for(1ms);
+   throw std::runtime_error{"device error"};
+}
+
+
+// Polls for a stop request instead of sleeping for the full delay.
+task<int> cancellable_value(timer_queue& timers, std::stop_token stop, int x, std::chrono::milliseconds delay) {
+   FrameCounter counter;
+   for(auto t = 0ms; t < delay; t += 1ms) {
+      if(stop.stop_requested()) {
+         co_return -1;
+      }
+      co_await timers.sleep_for(1ms);
+   }
+   co_return x;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename F>
+double ns_per_call(unsigned iterations, F&& f) {
+   auto t0 = std::chrono::steady_clock::now();
+   for(unsigned i = 0; i < iterations; ++i) {
+      f(int(i));
+   }
+   return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / iterations;
+}
+
+
+task<int> wrapped_sum(thread_pool& pool, timer_queue& timers, int n) {
+   co_await pool.schedule();
+   int sum = 0;
+   for(int i = 0; i < n; ++i) {
+      sum += *co_await with_timeout(timers, pooled_value(pool, 1), 10s);
+   }
+   co_return sum;
+}
+
+
+task<int> plain_sum(thread_pool& pool, int n) {
+   co_await pool.schedule();
+   int sum = 0;
+   for(int i = 0; i < n; ++i) {
+      sum += co_await pooled_value(pool, 1);
+   }
+   co_return sum;
+}
+
+
+// Many coroutines with their timers armed at the same time.
+double concurrent_ns(thread_pool& pool, timer_queue& timers, unsigned coroutines, int per_coroutine, bool wrapped) {
+   std::vector<task<int>> tasks;
+   for(unsigned c = 0; c < coroutines; ++c) {
+      tasks.push_back(wrapped ? wrapped_sum(pool, timers, per_coroutine) : plain_sum(pool, per_coroutine));
+   }
+   auto t0 = std::chrono::steady_clock::now();
+   auto sums = sync_wait(when_all(std::move(tasks)));
+   auto dt = std::chrono::steady_clock::now() - t0;
+   for(auto s : sums) {
+      if(s != per_coroutine) {
+         std::abort();
+      }
+   }
+   return std::chrono::duration<double, std::nano>(dt).count() / (double(coroutines) * per_coroutine);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const unsigned iterations = argc > 1 ? unsigned(std::stoul(argv[1])) : 100000;
+   thread_pool pool;
+   timer_queue timers{pool};
+
+   {
+      const auto fast = sync_wait(with_timeout(timers, slow_value(timers, 1, 1ms), 1s));
+      const auto slow = sync_wait(with_timeout(timers, slow_value(timers, 2, 200ms), 10ms));
+      bool thrown = false;
+      try {
+         sync_wait(with_timeout(timers, slow_throw(timers), 1s));
+      } catch(const std::runtime_error&) {
+         thrown = true;
+      }
+      if(fast != 1 || slow || !thrown) {
+         std::cerr << "with_timeout gave a wrong result\n";
+         return EXIT_FAILURE;
+      }
+
+      // The timeout is seen as a stop request and ends the operation early.
+      auto t0 = std::chrono::steady_clock::now();
+      auto r = sync_wait(with_timeout(
+         timers, [&](std::stop_token stop) { return cancellable_value(timers, stop, 3, 10s); }, 10ms));
+      while(live_frames > 0 && std::chrono::steady_clock::now() - t0 < 1s) {
+         std::this_thread::sleep_for(1ms);
+      }
+      if(r || live_frames > 0) {
+         std::cerr << "the timed out operation was not cancelled\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   std::cout << "timeout never fires, " << pool.size() << " pool threads\n";
+   std::cout << std::setw(34) << "await" << std::setw(14) << "plain ns" << std::setw(14) << "wrapped ns"
+             << std::setw(14) << "overhead ns" << '\n';
+   auto row = [](const char* name, double plain, double wrapped) {
+      std::cout << std::setw(34) << name << std::fixed << std::setprecision(0) << std::setw(14) << plain
+                << std::setw(14) << wrapped << std::setw(14) << wrapped - plain << '\n';
+   };
+
+   {
+      auto plain = ns_per_call(iterations, [](int i) {
+         if(sync_wait(inline_value(i)) != i) {
+            std::abort();
+         }
+      });
+      auto wrapped = ns_per_call(iterations, [&](int i) {
+         if(*sync_wait(with_timeout(timers, inline_value(i), 10s)) != i) {
+            std::abort();
+         }
+      });
+      row("inline, one at a time", plain, wrapped);
+   }
+
+   {
+      auto plain = ns_per_call(iterations, [&](int i) {
+         if(sync_wait(pooled_value(pool, i)) != i) {
+            std::abort();
+         }
+      });
+      auto wrapped = ns_per_call(iterations, [&](int i) {
+         if(*sync_wait(with_timeout(timers, pooled_value(pool, i), 10s)) != i) {
+            std::abort();
+         }
+      });
+      row("thread pool hop, one at a time", plain, wrapped);
+   }
+
+   {
+      constexpr unsigned coroutines = 4096;
+      const int per_coroutine = int(std::max(1u, iterations / coroutines));
+      auto plain = concurrent_ns(pool, timers, coroutines, per_coroutine, false);
+      auto wrapped = concurrent_ns(pool, timers, coroutines, per_coroutine, true);
+      row("thread pool hop, 4096 concurrent", plain, wrapped);
+   }
+
+   if(live_frames != 0) {
+      std::cerr << live_frames << " frames leaked\n";
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
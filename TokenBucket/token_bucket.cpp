@@ -0,0 +1,208 @@
+#include "async_token_bucket.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "timer_queue.hpp"
+#include "when_all.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+constexpr std::size_t file_size = 8 << 20;
+constexpr std::size_t chunk = 256 << 10;
+constexpr unsigned files = 8;
+constexpr unsigned readers = 32;
+constexpr unsigned chunks_per_burst = 16;
+constexpr auto mean_gap = 20ms;
+constexpr auto window = 10ms;
+
+
+struct Limits {
+   const char* name;
+   double bytes_per_second;  // 0 for no limit
+   double requests_per_second;
+};
+
+
+// Bandwidth and request rate limits shared by all readers of a job.
+struct Limiter {
+   Limiter(timer_queue& timers, const Limits& limits) {
+      // Allow bursts of one refill window, but at least one request.
+      if(limits.bytes_per_second > 0) {
+         auto burst = std::max<std::uint64_t>(chunk, std::uint64_t(limits.bytes_per_second * 0.01));
+         bytes.emplace(timers, limits.bytes_per_second, burst);
+      }
+      if(limits.requests_per_second > 0) {
+         auto burst = std::max<std::uint64_t>(1, std::uint64_t(limits.requests_per_second * 0.01));
+         requests.emplace(timers, limits.requests_per_second, burst);
+      }
+   }
+
+   std::optional<async_token_bucket> bytes;
+   std::optional<async_token_bucket> requests;
+};
+
+
+using Sample = std::pair<std::chrono::steady_clock::time_point, std::size_t>;
+
+
+// Idles for a random time, then reads a burst of chunks back to back. Runs on
+// the thread pool after the first sleep.
+task<std::vector<Sample>> reader(timer_queue& timers, Limiter& limiter, int fd, unsigned id, unsigned bursts) {
+   std::minstd_rand rng{id + 1};
+   std::uniform_int_distribution<long> gap{0, 2 * mean_gap.count()};
+   std::vector<char> buffer(chunk);
+   std::vector<Sample> samples;
+   std::size_t offset = std::size_t(id) * chunk % file_size;
+
+   for(unsigned b = 0; b < bursts; ++b) {
+      co_await timers.sleep_for(std::chrono::milliseconds{gap(rng)});
+      for(unsigned c = 0; c < chunks_per_burst; ++c) {
+         if(limiter.requests) {
+            co_await limiter.requests->acquire();
+         }
+         if(limiter.bytes) {
+            co_await limiter.bytes->acquire(chunk);
+         }
+         auto n = ::pread(fd, buffer.data(), chunk, off_t(offset));
+         if(n != ssize_t(chunk)) {
+            throw std::runtime_error{"short read"};
+         }
+         samples.emplace_back(std::chrono::steady_clock::now(), chunk);
+         offset = (offset + chunk) % file_size;
+      }
+   }
+   co_return samples;
+}
+
+
+void run(timer_queue& timers, const std::vector<int>& fds, unsigned bursts, const Limits& limits) {
+   Limiter limiter{timers, limits};
+   std::vector<task<std::vector<Sample>>> tasks;
+   for(unsigned r = 0; r < readers; ++r) {
+      tasks.push_back(reader(timers, limiter, fds[r % fds.size()], r, bursts));
+   }
+   auto t0 = std::chrono::steady_clock::now();
+   auto per_reader = sync_wait(when_all(std::move(tasks)));
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+   // Bytes read per window of wall time.
+   std::vector<double> windows(std::size_t(dt / window) + 1, 0.);
+   std::size_t total = 0;
+   for(const auto& samples : per_reader) {
+      for(auto [t, bytes] : samples) {
+         windows[std::size_t((t - t0) / window)] += double(bytes);
+         total += bytes;
+      }
+   }
+   if(total != std::size_t(readers) * bursts * chunks_per_burst * chunk) {
+      std::cerr << "read " << total << " bytes\n";
+      std::exit(EXIT_FAILURE);
+   }
+
+   const double to_mb_s = 1. / (1 << 20) / std::chrono::duration<double>(window).count();
+   double mean = 0, peak = 0;
+   for(auto& w : windows) {
+      w *= to_mb_s;
+      mean += w;
+      peak = std::max(peak, w);
+   }
+   mean /= double(windows.size());
+   double var = 0;
+   for(auto w : windows) {
+      var += (w - mean) * (w - mean);
+   }
+   auto cv = std::sqrt(var / double(windows.size())) / mean;
+
+   auto achieved = double(total) / (1 << 20) / dt.count();
+   auto limit = std::min(limits.bytes_per_second > 0 ? limits.bytes_per_second : INFINITY,
+                         limits.requests_per_second > 0 ? limits.requests_per_second * chunk : INFINITY);
+   // The long term rate can only exceed the limit by the initial bursts.
+   if(std::isfinite(limit) && achieved > 1.05 * limit / (1 << 20) + 1. / dt.count()) {
+      std::cerr << limits.name << ": " << achieved << " MB/s over the limit\n";
+      std::exit(EXIT_FAILURE);
+   }
+
+   std::cout << std::setw(24) << limits.name << std::fixed << std::setprecision(2) << std::setw(10) << dt.count()
+             << std::setprecision(0) << std::setw(12) << achieved << std::setw(14) << peak << std::setprecision(2)
+             << std::setw(12) << cv << '\n';
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const unsigned bursts = argc > 1 ? unsigned(std::stoul(argv[1])) : 4;
+   thread_pool pool;
+   timer_queue timers{pool};
+
+   {
+      async_token_bucket bucket{timers, 1000., 10};
+      const bool burst = bucket.try_acquire(10);
+      const bool empty = !bucket.try_acquire(5);
+      bool oversize = false;
+      try {
+         bucket.acquire(11);
+      } catch(const std::invalid_argument&) {
+         oversize = true;
+      }
+      // 100 more tokens at 1000 per second.
+      auto t0 = std::chrono::steady_clock::now();
+      sync_wait([&]() -> task<> {
+         for(int i = 0; i < 10; ++i) {
+            co_await bucket.acquire(10);
+         }
+      }());
+      auto dt = std::chrono::steady_clock::now() - t0;
+      if(!burst || !empty || !oversize || dt < 90ms || dt >= 1s) {
+         std::cerr << "token bucket burst, size check or rate is wrong\n";
+         return EXIT_FAILURE;
+      }
+   }
+
+   auto root = std::filesystem::temp_directory_path() / ("token_bucket_" + std::to_string(::getpid()));
+   std::filesystem::create_directories(root);
+   std::vector<int> fds;
+   for(unsigned f = 0; f < files; ++f) {
+      auto path = root / (std::to_string(f) + ".bin");
+      std::vector<char> data(file_size, char(f));
+      std::ofstream{path, std::ios::binary}.write(data.data(), std::streamsize(data.size()));
+      fds.push_back(::open(path.c_str(), O_RDONLY));
+   }
+
+   std::cout << readers << " readers, " << bursts << " bursts of " << chunks_per_burst << " x " << (chunk >> 10)
+             << " kB, " << pool.size() << " pool threads\n";
+   std::cout << std::setw(24) << "limit" << std::setw(10) << "time s" << std::setw(12) << "MB/s" << std::setw(14)
+             << "peak MB/s" << std::setw(12) << "cv" << '\n';
+   const std::vector<Limits> limits{
+      {"none", 0, 0},
+      {"400 MB/s", 400. * (1 << 20), 0},
+      {"200 MB/s", 200. * (1 << 20), 0},
+      {"400 MB/s, 800 req/s", 400. * (1 << 20), 800},
+   };
+   for(const auto& l : limits) {
+      run(timers, fds, bursts, l);
+   }
+
+   for(auto fd : fds) {
+      ::close(fd);
+   }
+   std::filesystem::remove_all(root);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,305 @@
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+#include "whiteboard.hpp"
+
+#include <any>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+struct Track {
+   float px, py, pz, e;
+};
+
+
+// Product i of an event, one in three of each type.
+int int_value(std::size_t e, std::size_t i) {
+   return int(e + i);
+}
+
+double double_value(std::size_t e, std::size_t i) {
+   return double(e + i) * 0.5;
+}
+
+Track track_value(std::size_t e, std::size_t i) {
+   return {float(e % 1000), float(i), 1.f, 2.f};
+}
+
+double weight(const Track& t) {
+   return t.px + t.py + t.pz + t.e;
+}
+
+
+// The baseline: products by name, of any type.
+template <bool Locked>
+class map_store {
+public:
+   template <typename T>
+   void put(const std::string& name, T value) {
+      std::unique_lock lock{mutex_, std::defer_lock};
+      if constexpr(Locked) {
+         lock.lock();
+      }
+      if(!products_.emplace(name, std::move(value)).second) {
+         throw std::logic_error{name + " put twice"};
+      }
+   }
+
+   template <typename T>
+   const T& get(const std::string& name) {
+      std::unique_lock lock{mutex_, std::defer_lock};
+      if constexpr(Locked) {
+         lock.lock();
+      }
+      return std::any_cast<const T&>(products_.at(name));
+   }
+
+   void clear() {
+      products_.clear();
+   }
+
+private:
+   std::mutex mutex_;
+   std::unordered_map<std::string, std::any> products_;
+};
+
+
+struct Names {
+   std::vector<std::string> ints, doubles, tracks;
+};
+
+struct Keys {
+   std::vector<product_key<int>> ints;
+   std::vector<product_key<double>> doubles;
+   std::vector<product_key<Track>> tracks;
+};
+
+
+template <typename Store>
+void put_event(Store& store, const Names& names, std::size_t e) {
+   for(std::size_t i = 0; i < names.ints.size(); ++i) {
+      store.template put<int>(names.ints[i], int_value(e, i));
+   }
+   for(std::size_t i = 0; i < names.doubles.size(); ++i) {
+      store.template put<double>(names.doubles[i], double_value(e, i));
+   }
+   for(std::size_t i = 0; i < names.tracks.size(); ++i) {
+      store.template put<Track>(names.tracks[i], track_value(e, i));
+   }
+}
+
+void put_event(whiteboard& board, const Keys& keys, std::size_t e) {
+   for(std::size_t i = 0; i < keys.ints.size(); ++i) {
+      board.put(keys.ints[i], int_value(e, i));
+   }
+   for(std::size_t i = 0; i < keys.doubles.size(); ++i) {
+      board.put(keys.doubles[i], double_value(e, i));
+   }
+   for(std::size_t i = 0; i < keys.tracks.size(); ++i) {
+      board.put(keys.tracks[i], track_value(e, i));
+   }
+}
+
+
+template <typename Store>
+double get_event(Store& store, const Names& names) {
+   double sum = 0;
+   for(const auto& n : names.ints) {
+      sum += store.template get<int>(n);
+   }
+   for(const auto& n : names.doubles) {
+      sum += store.template get<double>(n);
+   }
+   for(const auto& n : names.tracks) {
+      sum += weight(store.template get<Track>(n));
+   }
+   return sum;
+}
+
+double get_event(const whiteboard& board, const Keys& keys) {
+   double sum = 0;
+   for(auto k : keys.ints) {
+      sum += *board.try_get(k);
+   }
+   for(auto k : keys.doubles) {
+      sum += *board.try_get(k);
+   }
+   for(auto k : keys.tracks) {
+      sum += weight(*board.try_get(k));
+   }
+   return sum;
+}
+
+task<double> await_event(whiteboard& board, const Keys& keys) {
+   double sum = 0;
+   for(auto k : keys.ints) {
+      sum += co_await board.get(k);
+   }
+   for(auto k : keys.doubles) {
+      sum += co_await board.get(k);
+   }
+   for(auto k : keys.tracks) {
+      sum += weight(co_await board.get(k));
+   }
+   co_return sum;
+}
+
+
+task<double> await_events(whiteboard& board, const Keys& keys, std::size_t events) {
+   double sum = 0;
+   for(std::size_t e = 0; e < events; ++e) {
+      sum += co_await await_event(board, keys);
+   }
+   co_return sum;
+}
+
+
+// Millions of operations per second of f(), which returns a checksum.
+template <typename F>
+double rate(std::size_t operations, F f, double& sum) {
+   auto t0 = std::chrono::steady_clock::now();
+   sum = f();
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   return double(operations) / dt.count() / 1e6;
+}
+
+
+// Puts of events into store, cleared after each, and gets of the products
+// of one event, repeatedly.
+template <typename Store, typename Ids, typename Get>
+void measure(const char* label, Store& store, const Ids& ids, std::size_t products, std::size_t events, Get get,
+             double expected, bool& same) {
+   double sum;
+   const double puts = rate(
+       events * products,
+       [&] {
+          for(std::size_t e = 0; e < events; ++e) {
+             put_event(store, ids, e);
+             store.clear();
+          }
+          return 0.;
+       },
+       sum);
+   put_event(store, ids, 0);
+   const double gets = rate(events * products, [&] { return get(store); }, sum);
+   store.clear();
+   same &= sum == expected;
+   std::cout << std::setw(32) << label << std::setw(12) << puts << std::setw(12) << gets << '\n';
+}
+
+
+task<double> consume(thread_pool& pool, whiteboard& board, const Keys& keys) {
+   co_await pool.schedule();
+   co_return co_await await_event(board, keys);
+}
+
+task<double> produce(thread_pool& pool, whiteboard& board, const Keys& keys, std::size_t e) {
+   co_await pool.schedule();
+   put_event(board, keys, e);
+   co_return 0.;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[]) {
+   const std::size_t products = argc > 1 ? std::stoul(argv[1]) : 96;
+   const std::size_t events = argc > 2 ? std::stoul(argv[2]) : 100000;
+
+   // Configuration: the names are resolved to keys once.
+   whiteboard_schema schema;
+   Names names;
+   Keys keys;
+   for(std::size_t i = 0; i < products; ++i) {
+      auto name = "/Event/Rec/Product" + std::to_string(i);
+      if(i % 3 == 0) {
+         keys.ints.push_back(schema.declare<int>(name));
+         names.ints.push_back(name);
+      } else if(i % 3 == 1) {
+         keys.doubles.push_back(schema.declare<double>(name));
+         names.doubles.push_back(name);
+      } else {
+         keys.tracks.push_back(schema.declare<Track>(name));
+         names.tracks.push_back(name);
+      }
+   }
+   whiteboard board{schema};
+
+   bool rejected = false;
+   try {
+      board.put(schema.key<int>("/Event/Rec/Product0"), 1);
+      board.put(schema.key<int>("/Event/Rec/Product0"), 2);
+   } catch(const std::logic_error&) {
+      rejected = true;
+   }
+   board.clear();
+   if(!rejected || board.count() != 0) {
+      std::cerr << "a product was put twice\n";
+      return EXIT_FAILURE;
+   }
+
+   map_store<false> map;
+   map_store<true> locked_map;
+   put_event(map, names, 0);
+   const double event_sum = get_event(map, names), expected = double(events) * event_sum;
+   map.clear();
+
+   std::cout << products << " products per event, " << events << " events, M operations/s\n";
+   std::cout << std::setw(32) << "" << std::setw(12) << "puts" << std::setw(12) << "gets" << '\n';
+   std::cout << std::fixed << std::setprecision(1);
+   bool same = true;
+   auto repeat = [&](const auto& ids) {
+      return [&](auto& store) {
+         double sum = 0;
+         for(std::size_t e = 0; e < events; ++e) {
+            sum += get_event(store, ids);
+         }
+         return sum;
+      };
+   };
+   measure("unordered_map<string, any>", map, names, products, events, repeat(names), expected, same);
+   measure("  with a mutex", locked_map, names, products, events, repeat(names), expected, same);
+   measure("whiteboard, try_get", board, keys, products, events, repeat(keys), expected, same);
+   measure(
+       "whiteboard, co_await get", board, keys, products, events,
+       [&](whiteboard& b) { return sync_wait(await_events(b, keys, events)); }, expected, same);
+
+   // Consumers wait on a pool for the products of a producer, an event at a time.
+   thread_pool pool;
+   const std::size_t consumers = 4, waited_events = events / 10;
+   double sum = 0;
+   auto t0 = std::chrono::steady_clock::now();
+   for(std::size_t e = 0; e < waited_events; ++e) {
+      std::vector<task<double>> tasks;
+      for(std::size_t c = 0; c < consumers; ++c) {
+         tasks.push_back(consume(pool, board, keys));
+      }
+      tasks.push_back(produce(pool, board, keys, 0));
+      auto sums = sync_wait(when_all(std::move(tasks)));
+      for(auto s : sums) {
+         sum += s;
+      }
+      board.clear();
+   }
+   std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+   same &= sum == double(waited_events * consumers) * event_sum;
+   std::cout << "\n1 producer and " << consumers << " waiting consumers on " << pool.size() << " threads: "
+             << double(waited_events) / dt.count() << " events/s, "
+             << double(waited_events * consumers * products) / dt.count() / 1e6 << " M gets/s\n";
+
+   if(!same) {
+      std::cerr << "sums differ between the stores\n";
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}